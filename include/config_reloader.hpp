@@ -0,0 +1,90 @@
+#ifndef _CONFIG_RELOADER_H_
+#define _CONFIG_RELOADER_H_
+
+#include <string>
+
+#include "event_loop.hpp"
+#include "octopOS_driver.hpp"
+#include "watchdog.hpp"
+
+/** How long to wait after a change to the config or the modules
+ *  directory before reloading, so that a burst of changes (an editor
+ *  saving, a module being copied in) is applied once.
+ */
+extern const int64_t RELOAD_DEBOUNCE_MS;
+
+/**
+ * @brief Applies changes to the octopOS config and its
+ * `modules_enabled` directory while the driver runs.
+ *
+ * Both are watched with inotify from the babysitting loop. On a change
+ * the config is re-read, the enabled modules are diffed against the
+ * managed ones (see `diff_modules`) and only the difference is applied
+ * (see `apply_module_diff`). Unchanged modules keep running. A config
+ * that can't be read or parsed is ignored, keeping the last good one.
+ */
+class ConfigReloader {
+public:
+    /**
+     * @brief Create a reloader. Nothing is watched until `start`.
+     *
+     * @param loop The babysitting loop.
+     * @param config_path The path of the octopOS config.
+     * @param config The config the modules were launched with.
+     * @param next_key The next unused memory key.
+     * @param modules The set of active modules, which *will be mutated.*
+     * @param downgrade_pub The publisher for downgrade requests.
+     * @param scheduler The scheduler holding delayed restarts, if any.
+     * @param watchdog The watchdog to update with added and reconfigured
+     * modules, if any.
+     */
+    ConfigReloader(EventLoop *loop, const FilePath &config_path,
+                   const json &config, MemKey next_key, ModuleInfo *modules,
+                   publisher<OctoString> *downgrade_pub,
+                   RestartScheduler *scheduler = NULL,
+                   Watchdog *watchdog = NULL);
+
+    /** Stops watching. */
+    ~ConfigReloader();
+
+    /**
+     * @brief Start watching the config and the modules directory.
+     *
+     * @return Success status.
+     */
+    bool start();
+
+    /** Re-read the config and apply any changes now. */
+    void reload();
+
+    /** @return The config currently applied. */
+    const json& current_config() const { return config; }
+
+    /** @return The next unused memory key. */
+    MemKey next_memkey() const { return next_key; }
+
+private:
+    EventLoop *loop;
+    FilePath config_path;
+    json config;
+    MemKey next_key;
+    ModuleInfo *modules;
+    publisher<OctoString> *downgrade_pub;
+    RestartScheduler *scheduler;
+    Watchdog *watchdog;
+
+    int inotify_fd;
+    int config_dir_wd;
+    int modules_dir_wd;
+    FilePath modules_dir;
+    bool reload_scheduled;
+    TimerId reload_timer;
+
+    void watch_modules_dir(const FilePath &dir);
+    void handle_events();
+
+    ConfigReloader(const ConfigReloader&);
+    ConfigReloader& operator=(const ConfigReloader&);
+};
+
+#endif /* _CONFIG_RELOADER_H_ */
@@ -0,0 +1,140 @@
+#ifndef _EVENT_LOOP_H_
+#define _EVENT_LOOP_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include "timer_wheel.hpp"
+
+/**
+ * @brief A single-threaded, epoll-based event loop. The loop blocks
+ * until a watched file descriptor becomes readable, a watched signal
+ * arrives, a timer expires or work is posted from another thread, so
+ * it uses no CPU while idle.
+ *
+ * All callbacks run on the thread calling `run` / `run_once`. Only
+ * `post` and `stop` may be called from other threads.
+ */
+class EventLoop {
+public:
+    typedef std::function<void()> Callback;
+
+    /**
+     * @brief Create a new event loop. Throws std::runtime_error if the
+     * underlying epoll, eventfd or timerfd descriptors can't be created.
+     */
+    EventLoop();
+    ~EventLoop();
+
+    /**
+     * @brief Call `on_readable` every time `fd` becomes readable.
+     *
+     * @param fd The descriptor to watch. The loop does not take ownership.
+     * @param on_readable The callback to run.
+     * @return Success status.
+     */
+    bool watch(int fd, Callback on_readable);
+
+    /**
+     * @brief Stop watching `fd`.
+     *
+     * @param fd A descriptor previously passed to `watch`.
+     */
+    void unwatch(int fd);
+
+    /**
+     * @brief Call `on_signal` every time `signo` is delivered to the
+     * process. *The signal must be blocked in every thread of the
+     * process* (see `block_child_signals`), otherwise it may be
+     * consumed by a thread that isn't running this loop.
+     *
+     * @param signo The signal to watch.
+     * @param on_signal The callback to run.
+     * @return Success status.
+     */
+    bool watch_signal(int signo, Callback on_signal);
+
+    /**
+     * @brief Run `callback` once, `delay_ms` milliseconds from now.
+     * Timers have millisecond resolution and cost O(1) to schedule and
+     * cancel (see `TimerWheel`).
+     *
+     * @param delay_ms The delay in milliseconds.
+     * @param callback The callback to run.
+     * @return The ID of the new timer, which can be given to `cancel`.
+     */
+    TimerId schedule(int64_t delay_ms, Callback callback);
+
+    /**
+     * @brief Cancel a pending timer. Cancelling a timer that has
+     * already fired is a no-op.
+     *
+     * @param id The timer to cancel.
+     */
+    void cancel(TimerId id);
+
+    /**
+     * @brief Run `callback` on the loop thread as soon as possible.
+     * Safe to call from any thread.
+     *
+     * @param callback The callback to run.
+     */
+    void post(Callback callback);
+
+    /**
+     * @brief Wait for and dispatch one batch of events.
+     *
+     * @param timeout_ms The maximum time to block, or -1 to block
+     * until an event arrives.
+     * @return The number of events dispatched.
+     */
+    int run_once(int timeout_ms = -1);
+
+    /**
+     * @brief Dispatch events until `stop` is called.
+     */
+    void run();
+
+    /**
+     * @brief Make `run` return after the current batch of events.
+     * Safe to call from any thread.
+     */
+    void stop();
+
+    /**
+     * @brief The current time of the loop's monotonic clock.
+     *
+     * @return Milliseconds since an arbitrary, fixed point.
+     */
+    static int64_t now_ms();
+
+private:
+    EventLoop(const EventLoop&);
+    EventLoop& operator=(const EventLoop&);
+
+    void wake();
+    void drain_posted();
+    void fire_timers();
+    void rearm_timer();
+
+    int epoll_fd;
+    int wake_fd;
+    int timer_fd;
+    std::atomic<bool> stopped;
+
+    std::map<int, Callback> fd_callbacks;
+    /** The signalfd for each watched signal. */
+    std::map<int, int> signal_fds;
+
+    /** Pending timers. The timerfd is armed for its next deadline. */
+    TimerWheel timers;
+
+    std::mutex posted_mutex;
+    std::vector<Callback> posted;
+};
+
+#endif /* _EVENT_LOOP_H_ */
@@ -0,0 +1,252 @@
+#ifndef _HEARTBEAT_H_
+#define _HEARTBEAT_H_
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "module_registry.hpp"
+
+/** The name of the driver's heartbeat table, for `shm_open`. */
+const char* const HEARTBEAT_TABLE_NAME = "/octopOS.heartbeats";
+/** Identifies an initialized heartbeat table ("OCHB"). */
+const uint32_t HEARTBEAT_TABLE_MAGIC = 0x4f434842;
+/** How often a module without an entry looks for it again. */
+const int64_t HEARTBEAT_ATTACH_RETRY_MS = 1000;
+
+/**
+ * @brief A module's entry in the heartbeat table. Each is on its own
+ * cache line, so that modules beating don't slow each other down.
+ */
+struct alignas(64) HeartbeatEntry {
+    /** The memory key, plus one, of the module the entry belongs to;
+     *  0 if unused. Written by the driver. */
+    std::atomic<int64_t> key;
+    /** Counts the module's heartbeats. Written by the module. */
+    std::atomic<uint64_t> beats;
+    /** The module's heartbeat deadline, or 0 if it isn't watched.
+     *  Written by the driver. */
+    std::atomic<int64_t> timeout_ms;
+};
+
+/** The layout of the start of the heartbeat table. Entries follow. */
+struct alignas(64) HeartbeatTableHeader {
+    /** `HEARTBEAT_TABLE_MAGIC` once the table is initialized. */
+    std::atomic<uint32_t> magic;
+    /** The number of entries. */
+    uint32_t capacity;
+    /** Set when a new driver replaced the table; modules should find
+     *  their entry in the new one. */
+    std::atomic<uint32_t> retired;
+};
+
+/**
+ * @brief A mapping of the heartbeat table, through which modules tell
+ * the driver's `Watchdog` that they are still making progress.
+ */
+class HeartbeatTable {
+public:
+    HeartbeatTable(): header(NULL), size(0) { }
+    HeartbeatTable(HeartbeatTable &&other): header(other.header),
+        size(other.size) {
+        other.header = NULL;
+        other.size = 0;
+    }
+    ~HeartbeatTable() { unmap(); }
+
+    /**
+     * @brief Create the table, replacing any left by a previous driver.
+     *
+     * @param capacity The number of entries.
+     * @return Success status.
+     */
+    bool create(uint32_t capacity) {
+        if (open()) {
+            header->retired.store(1);
+        }
+        unmap();
+        shm_unlink(HEARTBEAT_TABLE_NAME);
+        int fd = shm_open(HEARTBEAT_TABLE_NAME, O_RDWR | O_CREAT | O_EXCL,
+                          0660);
+        if (fd == -1) {
+            return false;
+        }
+        size_t bytes = sizeof(HeartbeatTableHeader) +
+            (size_t)capacity * sizeof(HeartbeatEntry);
+        bool ok = ftruncate(fd, bytes) == 0 && map(fd, bytes);
+        close(fd);
+        if (!ok) {
+            shm_unlink(HEARTBEAT_TABLE_NAME);
+            return false;
+        }
+        header->capacity = capacity;
+        header->magic.store(HEARTBEAT_TABLE_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Map the driver's table.
+     *
+     * @return false if there is no initialized table.
+     */
+    bool open() {
+        unmap();
+        int fd = shm_open(HEARTBEAT_TABLE_NAME, O_RDWR, 0);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 &&
+            (size_t)st.st_size >= sizeof(HeartbeatTableHeader) &&
+            map(fd, st.st_size);
+        close(fd);
+        if (ok && (header->magic.load(std::memory_order_acquire) !=
+                   HEARTBEAT_TABLE_MAGIC ||
+                   size < sizeof(HeartbeatTableHeader) +
+                   (size_t)header->capacity * sizeof(HeartbeatEntry))) {
+            unmap();
+            ok = false;
+        }
+        return ok;
+    }
+
+    /** Unmap the table. */
+    void unmap() {
+        if (header) {
+            munmap(header, size);
+        }
+        header = NULL;
+        size = 0;
+    }
+
+    /** Unmap the table and remove it. */
+    void destroy() {
+        unmap();
+        shm_unlink(HEARTBEAT_TABLE_NAME);
+    }
+
+    /** @return Whether the table is mapped. */
+    bool is_open() const { return header != NULL; }
+
+    /** @return Whether the table was replaced by a new one. */
+    bool is_retired() const {
+        return header->retired.load(std::memory_order_relaxed);
+    }
+
+    /** @return The number of entries. */
+    uint32_t capacity() const { return header->capacity; }
+
+    /** @return The entry at `index`, which must be below `capacity`. */
+    HeartbeatEntry& entry(uint32_t index) {
+        return reinterpret_cast<HeartbeatEntry*>(header + 1)[index];
+    }
+
+    /**
+     * @brief Find a module's entry.
+     *
+     * @param key The module's memory key.
+     * @return The entry, or NULL if the driver hasn't given it one.
+     */
+    HeartbeatEntry* find(MemKey key) {
+        for (uint32_t i = 0; i < capacity(); i++) {
+            if (entry(i).key.load(std::memory_order_acquire) == key + 1) {
+                return &entry(i);
+            }
+        }
+        return NULL;
+    }
+
+private:
+    HeartbeatTableHeader *header;
+    size_t size;
+
+    bool map(int fd, size_t bytes) {
+        void *addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          fd, 0);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        header = static_cast<HeartbeatTableHeader*>(addr);
+        size = bytes;
+        return true;
+    }
+
+    HeartbeatTable(const HeartbeatTable&);
+    HeartbeatTable& operator=(const HeartbeatTable&);
+};
+
+/**
+ * @brief A module's heartbeat. `beat` is a single store to shared
+ * memory, cheap enough to call from a module's main loop on every
+ * iteration. A module launched without a driver, or before the driver
+ * has set up its entry, looks for it again every
+ * `HEARTBEAT_ATTACH_RETRY_MS`, as does one whose driver was restarted.
+ */
+class Heartbeat {
+public:
+    /**
+     * @brief Create a heartbeat for a module.
+     *
+     * @param key The module's memory key.
+     */
+    explicit Heartbeat(MemKey _key = 0):
+        key(_key), entry(NULL), next_attach_ms(0) { }
+    Heartbeat(Heartbeat &&other): key(other.key),
+        table(std::move(other.table)), entry(other.entry),
+        next_attach_ms(other.next_attach_ms) {
+        other.entry = NULL;
+    }
+
+    /** Tell the driver the module is making progress. */
+    void beat() {
+        if ((!entry || table.is_retired()) && !attach()) {
+            return;
+        }
+        entry->beats.store(entry->beats.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    }
+
+    /**
+     * @return The module's heartbeat deadline in milliseconds, or 0 if
+     * the driver isn't watching it. Beat at least twice as often.
+     */
+    int64_t timeout_ms() {
+        if ((!entry || table.is_retired()) && !attach()) {
+            return 0;
+        }
+        return entry->timeout_ms.load(std::memory_order_relaxed);
+    }
+
+private:
+    MemKey key;
+    HeartbeatTable table;
+    HeartbeatEntry *entry;
+    int64_t next_attach_ms;
+
+    bool attach() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        int64_t now_ms = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+        if (now_ms < next_attach_ms) {
+            return false;
+        }
+        next_attach_ms = now_ms + HEARTBEAT_ATTACH_RETRY_MS;
+        entry = NULL;
+        if ((!table.is_open() || table.is_retired()) && !table.open()) {
+            return false;
+        }
+        entry = table.find(key);
+        return entry != NULL;
+    }
+
+    Heartbeat(const Heartbeat&);
+    Heartbeat& operator=(const Heartbeat&);
+};
+
+#endif /* _HEARTBEAT_H_ */
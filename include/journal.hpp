@@ -0,0 +1,214 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Optional.hpp"
+#include "module_registry.hpp"
+
+/** Where the driver keeps its journal unless the config's
+ *  `journal_path` says otherwise. */
+extern const char* JOURNAL_PATH;
+/** The size of the journal file unless the config's `journal_max_kb`
+ *  says otherwise. Once full, the oldest records are overwritten. */
+extern const size_t JOURNAL_MAX_BYTES;
+/** The number of records that can wait to be flushed. Records made
+ *  while it is full are dropped and counted. */
+extern const size_t JOURNAL_QUEUE_CAPACITY;
+/** How often the flusher moves waiting records to the file. */
+extern const int JOURNAL_FLUSH_MS;
+/** Identifies a journal file ("OCJL"). */
+const uint32_t JOURNAL_MAGIC = 0x4f434a4c;
+/** The version of the journal file layout. */
+const uint16_t JOURNAL_VERSION = 1;
+/** The slot of records that aren't about a managed module. */
+const uint32_t JOURNAL_NO_SLOT = UINT32_MAX;
+
+/** The supervisor events recorded in the journal. The meaning of a
+ *  record's `status` depends on its event. */
+enum JournalEvent {
+    /** The driver started; `pid` is the driver's. */
+    JOURNAL_DRIVER_START = 0,
+    /** A module was started. */
+    JOURNAL_LAUNCH = 1,
+    /** A module couldn't be started; `status` is the errno. */
+    JOURNAL_LAUNCH_FAILED = 2,
+    /** A module died; `status` is its wait status. */
+    JOURNAL_DEATH = 3,
+    /** A process that isn't a module died; `status` is its wait
+     *  status. */
+    JOURNAL_UNKNOWN_DEATH = 4,
+    /** A module's restart was delayed; `status` is the delay in ms. */
+    JOURNAL_BACKOFF = 5,
+    /** A module's downgrade was requested. */
+    JOURNAL_DOWNGRADE = 6,
+    /** A module's upgrade was requested. */
+    JOURNAL_UPGRADE = 7,
+    /** An upgrade of a disabled module was ignored. */
+    JOURNAL_UPGRADE_IGNORED = 8,
+    /** A module was killed intentionally; `status` is the signal. */
+    JOURNAL_KILL = 9,
+    /** A module missed its heartbeat deadline; `status` is the
+     *  deadline in ms. */
+    JOURNAL_HANG = 10,
+    /** A module was removed from the enabled modules. */
+    JOURNAL_RETIRE = 11
+};
+
+/** @return The name of a journal event, for tools printing records. */
+const char* journal_event_name(uint16_t event);
+
+/** One fixed-size journal record, as stored in the file. */
+struct JournalRecord {
+    /** CLOCK_REALTIME when the event happened, in nanoseconds. */
+    int64_t time_ns;
+    /** The module's slot, or `JOURNAL_NO_SLOT`. */
+    uint32_t slot;
+    /** The process the event is about, or -1. */
+    int32_t pid;
+    /** Event specific; see `JournalEvent`. */
+    int32_t status;
+    /** A `JournalEvent`. */
+    uint16_t event;
+    uint16_t reserved;
+};
+
+/** The layout of the start of a journal file. `capacity` records
+ *  follow; record `i` is at index `i % capacity`. */
+struct JournalFileHeader {
+    /** `JOURNAL_MAGIC`. */
+    uint32_t magic;
+    /** `JOURNAL_VERSION`. */
+    uint16_t version;
+    /** `sizeof(JournalRecord)`. */
+    uint16_t record_size;
+    /** The number of records the file holds. */
+    uint64_t capacity;
+    /** The number of records ever written, including overwritten ones. */
+    uint64_t written;
+    /** The number of records dropped because the queue was full. */
+    uint64_t dropped;
+    uint8_t reserved[32];
+};
+
+/**
+ * @brief A history of supervisor events for post-mortem analysis,
+ * kept in a memory-mapped file of fixed size.
+ *
+ * Recording an event doesn't block or make a system call, so it can
+ * be done on the restart path: the record is put in a lock-free
+ * multi-producer queue, and a background thread moves queued records
+ * into the mapped file. The file is a ring holding the newest records,
+ * and is appended to across driver restarts, so it can be downlinked
+ * as is and read with `read_journal`.
+ */
+class Journal {
+public:
+    /** Create a journal. Nothing is recorded until `open`. */
+    Journal();
+
+    /** Flushes waiting records and closes the file. */
+    ~Journal();
+
+    /**
+     * @brief Map the journal file, creating it if needed, and start
+     * the flusher. A file with the same layout is appended to;
+     * anything else at the path is replaced.
+     *
+     * @param path The journal file.
+     * @param max_bytes The size of the file.
+     * @return Success status.
+     */
+    bool open(const FilePath &path, size_t max_bytes = JOURNAL_MAX_BYTES);
+
+    /**
+     * @brief Record an event. Safe to call from any thread.
+     *
+     * @param event The `JournalEvent`.
+     * @param slot The module's slot, or `JOURNAL_NO_SLOT`.
+     * @param pid The process the event is about, or -1.
+     * @param status Event specific; see `JournalEvent`.
+     * @return false if the record was dropped because the queue is full.
+     */
+    bool record(JournalEvent event, uint32_t slot, pid_t pid,
+                int32_t status = 0);
+
+    /** Move all waiting records to the file and write it to disk. */
+    void flush();
+
+    /** @return Whether the journal file is mapped. */
+    bool is_open() const { return header != NULL; }
+
+    /** @return The number of records dropped so far. */
+    uint64_t dropped() const { return dropped_records; }
+
+private:
+    struct Cell {
+        /** The queue position this cell can next be written at, plus
+         *  one once it holds a record for that position. */
+        std::atomic<uint64_t> sequence;
+        JournalRecord record;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) uint64_t head;
+    std::atomic<uint64_t> dropped_records;
+
+    int fd;
+    size_t size;
+    JournalFileHeader *header;
+    JournalRecord *records;
+
+    /** Held by whoever is draining the queue. */
+    std::mutex drain_mutex;
+    std::mutex wake_mutex;
+    std::condition_variable wakeup;
+    bool stopping;
+    std::thread flusher;
+
+    size_t drain();
+    void flush_forever();
+    void close();
+
+    Journal(const Journal&);
+    Journal& operator=(const Journal&);
+};
+
+/**
+ * @brief Make a journal the one `journal_event` records to.
+ *
+ * @param journal The journal, or NULL to stop recording.
+ */
+void set_journal(Journal *journal);
+
+/**
+ * @brief Record an event to the journal set with `set_journal`, if
+ * any. Safe to call from any thread.
+ *
+ * @param event The `JournalEvent`.
+ * @param slot The module's slot, or `JOURNAL_NO_SLOT`.
+ * @param pid The process the event is about, or -1.
+ * @param status Event specific; see `JournalEvent`.
+ */
+void journal_event(JournalEvent event, ModuleSlot slot, pid_t pid,
+                   int32_t status = 0);
+
+/**
+ * @brief Read the records of a journal file, oldest first.
+ *
+ * @param path The journal file.
+ * @return The records, if the file is a journal.
+ */
+CDH::Optional< std::vector<JournalRecord> > read_journal(const FilePath &path);
+
+#endif /* _JOURNAL_H_ */
@@ -1,17 +1,379 @@
 #ifndef _JSON_H_
 #define _JSON_H_
 
-#include <string>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+/**
+ * @brief A minimal JSON value with a subset of the nlohmann::json
+ * interface, enough to read the octopOS config. Objects, arrays,
+ * strings, numbers, booleans and null are supported; numbers are
+ * stored as doubles.
+ *
+ * Reading a missing key or index through a const value yields null
+ * rather than throwing, so optional config sections can be read
+ * without checking for them first.
+ */
 class json {
 public:
-  std::string operator[](std::string key){
-    return key;
-  }
-  static json parse(std::istream &in) {
-    return json();
-  }
+    enum value_t { null_t, boolean_t, number_t, string_t, array_t, object_t };
+    typedef std::map<std::string, json> object_type;
+    typedef std::vector<json> array_type;
+
+    json(): type(null_t), boolean(false), number(0) { }
+    json(bool b): type(boolean_t), boolean(b), number(0) { }  // NOLINT
+    json(int n): type(number_t), boolean(false), number(n) { }  // NOLINT
+    json(long n): type(number_t), boolean(false), number(n) { }  // NOLINT
+    json(double n): type(number_t), boolean(false), number(n) { }  // NOLINT
+    json(const std::string &s):  // NOLINT
+        type(string_t), boolean(false), number(0), str(s) { }
+    json(const char *s):  // NOLINT
+        type(string_t), boolean(false), number(0), str(s) { }
+
+    /** @return An empty JSON object. */
+    static json object() {
+        json j;
+        j.type = object_t;
+        j.obj = std::make_shared<object_type>();
+        return j;
+    }
+
+    /** @return An empty JSON array. */
+    static json array() {
+        json j;
+        j.type = array_t;
+        j.arr = std::make_shared<array_type>();
+        return j;
+    }
+
+    /**
+     * @brief Parse a JSON document. Throws std::invalid_argument if the
+     * input isn't valid JSON.
+     *
+     * @param in The stream to read the document from.
+     * @return The parsed document.
+     */
+    static json parse(std::istream &in) {
+        std::string text((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+        return parse(text);
+    }
+
+    /** @see parse(std::istream&) */
+    static json parse(const std::string &text) {
+        size_t pos = 0;
+        json value = parse_value(text, &pos);
+        skip_whitespace(text, &pos);
+        if (pos != text.size()) {
+            throw std::invalid_argument("Trailing characters in JSON");
+        }
+        return value;
+    }
+
+    bool is_null() const { return type == null_t; }
+    bool is_boolean() const { return type == boolean_t; }
+    bool is_number() const { return type == number_t; }
+    bool is_string() const { return type == string_t; }
+    bool is_array() const { return type == array_t; }
+    bool is_object() const { return type == object_t; }
+
+    /** @return The number of elements of an array or object, else 0. */
+    size_t size() const {
+        if (type == array_t) return arr->size();
+        if (type == object_t) return obj->size();
+        return 0;
+    }
+
+    /** @return The number of members named `key` (0 or 1). */
+    size_t count(const std::string &key) const {
+        return type == object_t ? obj->count(key) : 0;
+    }
+
+    /** @return The member named `key`, or null if there is none. */
+    const json& operator[](const std::string &key) const {
+        if (type == object_t) {
+            object_type::const_iterator found = obj->find(key);
+            if (found != obj->end()) {
+                return found->second;
+            }
+        }
+        return null_value();
+    }
+
+    /** @return The member named `key`, inserting null if there is none. */
+    json& operator[](const std::string &key) {
+        if (type == null_t) {
+            *this = object();
+        }
+        if (type != object_t) {
+            throw std::domain_error("JSON value is not an object");
+        }
+        if (obj.use_count() > 1) {
+            // Copy on write, so that copies stay independent
+            obj = std::make_shared<object_type>(*obj);
+        }
+        return (*obj)[key];
+    }
+
+    /** @see operator[](const std::string&) const */
+    const json& operator[](const char *key) const {
+        return (*this)[std::string(key)];
+    }
+
+    /** @see operator[](const std::string&) */
+    json& operator[](const char *key) {
+        return (*this)[std::string(key)];
+    }
+
+    /** @return The element at `index`, or null if out of bounds. */
+    const json& operator[](size_t index) const {
+        if (type == array_t && index < arr->size()) {
+            return (*arr)[index];
+        }
+        return null_value();
+    }
+
+    /** @return The members of an object (empty for other values). */
+    const object_type& items() const {
+        static const object_type empty;
+        return type == object_t ? *obj : empty;
+    }
+
+    /**
+     * @brief Get the member named `key` converted to `T`, or
+     * `default_value` if there is no such member or it has another type.
+     */
+    template <typename T>
+    T value(const std::string &key, const T &default_value) const {
+        const json &member = (*this)[key];
+        T result;
+        return member.convert_to(&result) ? result : default_value;
+    }
+
+    /** @see value(const std::string&, const T&) */
+    std::string value(const std::string &key, const char *default_value) const {
+        return value(key, std::string(default_value));
+    }
+
+    /** Strings convert implicitly, as with nlohmann::json. */
+    operator std::string() const {
+        if (type != string_t) {
+            throw std::domain_error("JSON value is not a string");
+        }
+        return str;
+    }
+
+    bool operator==(const std::string &s) const {
+        return type == string_t && str == s;
+    }
+    bool operator==(const char *s) const {
+        return *this == std::string(s);
+    }
+    bool operator!=(const std::string &s) const { return !(*this == s); }
+    bool operator!=(const char *s) const { return !(*this == s); }
+
+    /**
+     * @brief Convert this value to `T`.
+     *
+     * @param out Where to store the converted value.
+     * @return Whether this value has a type convertible to `T`.
+     */
+    bool convert_to(bool *out) const {
+        if (type != boolean_t) return false;
+        *out = boolean;
+        return true;
+    }
+    bool convert_to(double *out) const {
+        if (type != number_t) return false;
+        *out = number;
+        return true;
+    }
+    bool convert_to(int *out) const {
+        if (type != number_t) return false;
+        *out = static_cast<int>(number);
+        return true;
+    }
+    bool convert_to(long *out) const {  // NOLINT
+        if (type != number_t) return false;
+        *out = static_cast<long>(number);  // NOLINT
+        return true;
+    }
+    bool convert_to(long long *out) const {  // NOLINT
+        if (type != number_t) return false;
+        *out = static_cast<long long>(number);  // NOLINT
+        return true;
+    }
+    bool convert_to(std::string *out) const {
+        if (type != string_t) return false;
+        *out = str;
+        return true;
+    }
+    bool convert_to(json *out) const {
+        *out = *this;
+        return true;
+    }
+
+private:
+    value_t type;
+    bool boolean;
+    double number;
+    std::string str;
+    // Containers are shared so that copies of a large config are cheap,
+    // and copied before being written through a shared reference.
+    std::shared_ptr<array_type> arr;
+    std::shared_ptr<object_type> obj;
+
+    static const json& null_value() {
+        static const json null;
+        return null;
+    }
+
+    static void skip_whitespace(const std::string &text, size_t *pos) {
+        while (*pos < text.size() &&
+               (text[*pos] == ' ' || text[*pos] == '\t' ||
+                text[*pos] == '\n' || text[*pos] == '\r')) {
+            (*pos)++;
+        }
+    }
+
+    static void expect(const std::string &text, size_t *pos, const char *word) {
+        for (const char *c = word; *c; c++, (*pos)++) {
+            if (*pos >= text.size() || text[*pos] != *c) {
+                throw std::invalid_argument("Invalid JSON literal");
+            }
+        }
+    }
+
+    static std::string parse_string(const std::string &text, size_t *pos) {
+        std::string result;
+        (*pos)++;  // opening quote
+        while (*pos < text.size() && text[*pos] != '"') {
+            char c = text[(*pos)++];
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (*pos >= text.size()) break;
+            char escaped = text[(*pos)++];
+            switch (escaped) {
+            case 'n': result += '\n'; break;
+            case 't': result += '\t'; break;
+            case 'r': result += '\r'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'u': {
+                if (*pos + 4 > text.size()) {
+                    throw std::invalid_argument("Invalid JSON escape");
+                }
+                unsigned long code =  // NOLINT
+                    strtoul(text.substr(*pos, 4).c_str(), NULL, 16);
+                *pos += 4;
+                // Config files are ASCII; anything else is kept as UTF-8
+                if (code < 0x80) {
+                    result += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    result += static_cast<char>(0xC0 | (code >> 6));
+                    result += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    result += static_cast<char>(0xE0 | (code >> 12));
+                    result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    result += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: result += escaped; break;
+            }
+        }
+        if (*pos >= text.size()) {
+            throw std::invalid_argument("Unterminated JSON string");
+        }
+        (*pos)++;  // closing quote
+        return result;
+    }
+
+    static json parse_value(const std::string &text, size_t *pos) {
+        skip_whitespace(text, pos);
+        if (*pos >= text.size()) {
+            throw std::invalid_argument("Unexpected end of JSON");
+        }
+        char c = text[*pos];
+        if (c == '{') {
+            json result = object();
+            (*pos)++;
+            skip_whitespace(text, pos);
+            if (*pos < text.size() && text[*pos] == '}') {
+                (*pos)++;
+                return result;
+            }
+            while (1) {
+                skip_whitespace(text, pos);
+                if (*pos >= text.size() || text[*pos] != '"') {
+                    throw std::invalid_argument("Expected JSON object key");
+                }
+                std::string key = parse_string(text, pos);
+                skip_whitespace(text, pos);
+                if (*pos >= text.size() || text[*pos] != ':') {
+                    throw std::invalid_argument("Expected ':' in JSON object");
+                }
+                (*pos)++;
+                (*result.obj)[key] = parse_value(text, pos);
+                skip_whitespace(text, pos);
+                if (*pos < text.size() && text[*pos] == ',') {
+                    (*pos)++;
+                } else if (*pos < text.size() && text[*pos] == '}') {
+                    (*pos)++;
+                    return result;
+                } else {
+                    throw std::invalid_argument("Expected ',' or '}' in JSON");
+                }
+            }
+        } else if (c == '[') {
+            json result = array();
+            (*pos)++;
+            skip_whitespace(text, pos);
+            if (*pos < text.size() && text[*pos] == ']') {
+                (*pos)++;
+                return result;
+            }
+            while (1) {
+                result.arr->push_back(parse_value(text, pos));
+                skip_whitespace(text, pos);
+                if (*pos < text.size() && text[*pos] == ',') {
+                    (*pos)++;
+                } else if (*pos < text.size() && text[*pos] == ']') {
+                    (*pos)++;
+                    return result;
+                } else {
+                    throw std::invalid_argument("Expected ',' or ']' in JSON");
+                }
+            }
+        } else if (c == '"') {
+            return json(parse_string(text, pos));
+        } else if (c == 't') {
+            expect(text, pos, "true");
+            return json(true);
+        } else if (c == 'f') {
+            expect(text, pos, "false");
+            return json(false);
+        } else if (c == 'n') {
+            expect(text, pos, "null");
+            return json();
+        }
+        const char *start = text.c_str() + *pos;
+        char *end;
+        double number = strtod(start, &end);
+        if (end == start) {
+            throw std::invalid_argument("Invalid JSON value");
+        }
+        *pos += end - start;
+        return json(number);
+    }
 };
 
 #endif /* _JSON_H_ */
@@ -0,0 +1,130 @@
+#ifndef _LISTENER_POOL_H_
+#define _LISTENER_POOL_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Serves many tentacles from a small, fixed pool of worker
+ * threads, instead of one blocked thread per tentacle.
+ *
+ * Each tentacle is served by a non-blocking `Serve` function which
+ * handles at most `budget` waiting messages and returns how many it
+ * handled. Tentacles are sharded over the workers by index. A worker
+ * sweeps its shard until a whole sweep finds nothing to do, then
+ * sleeps; it is woken early by `notify`, or after an idle interval
+ * that doubles up to `MAX_IDLE_MS` for transports that can't notify.
+ *
+ * Threads and memory are bounded: the workers and the tentacle table
+ * are allocated once, when the pool is created.
+ */
+class ListenerPool {
+public:
+    /**
+     * @brief Handles up to `budget` messages waiting on a tentacle
+     * without blocking.
+     *
+     * @return The number of messages handled.
+     */
+    typedef std::function<size_t(int tentacle, size_t budget)> Serve;
+
+    /** The most messages served from one tentacle per sweep, so that
+     *  a busy tentacle can't starve the others in its shard. */
+    static const size_t SERVE_BUDGET = 16;
+    /** The shortest sleep of an idle worker. */
+    static const int MIN_IDLE_MS = 1;
+    /** The longest sleep of an idle worker. */
+    static const int MAX_IDLE_MS = 16;
+
+    /**
+     * @brief Create a pool and start its workers.
+     *
+     * @param max_tentacles The number of tentacle indices, from 0, that
+     * the pool can serve.
+     * @param workers The number of worker threads; 0 for one per CPU,
+     * up to 4.
+     */
+    explicit ListenerPool(size_t max_tentacles, unsigned workers = 0);
+
+    /** Stops and joins the workers. */
+    ~ListenerPool();
+
+    /**
+     * @brief Start serving a tentacle.
+     *
+     * @param tentacle The tentacle's index.
+     * @param serve The tentacle's serve function.
+     * @return false if the index is out of range or already served.
+     */
+    bool add(int tentacle, Serve serve);
+
+    /**
+     * @brief Stop serving a tentacle. Its serve function is not running
+     * and won't be called again once this returns.
+     *
+     * @param tentacle The tentacle's index.
+     * @return Whether the tentacle was being served.
+     */
+    bool remove(int tentacle);
+
+    /**
+     * @brief Wake the worker serving a tentacle, e.g. because a message
+     * was just queued on it.
+     *
+     * @param tentacle The tentacle's index.
+     */
+    void notify(int tentacle);
+
+    /** @return The number of worker threads. */
+    size_t worker_count() const { return shards.size(); }
+
+    /** @return The number of tentacles being served. */
+    size_t tentacle_count() const { return served_tentacles; }
+
+    /** @return The total number of messages handled so far. */
+    uint64_t messages_served() const { return served_messages; }
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool notified;
+        std::vector<int> tentacles;
+        std::thread thread;
+    };
+
+    std::vector<Serve> serves;
+    std::vector<Shard> shards;
+    std::atomic<bool> stopping;
+    std::atomic<size_t> served_tentacles;
+    std::atomic<uint64_t> served_messages;
+
+    Shard& shard_of(int tentacle) { return shards[tentacle % shards.size()]; }
+    void work(Shard *shard);
+
+    ListenerPool(const ListenerPool&);
+    ListenerPool& operator=(const ListenerPool&);
+};
+
+/**
+ * @brief Make a serve function for a System V message queue, the
+ * transport behind OctopOS tentacles.
+ *
+ * @param msqid The queue's ID.
+ * @param max_size The size of the largest message body.
+ * @param handle Called with the tentacle, type, body and body size of
+ * each message received.
+ * @return A serve function for `ListenerPool::add`.
+ */
+ListenerPool::Serve serve_message_queue(
+    int msqid, size_t max_size,
+    std::function<void(int tentacle, long type,  // NOLINT
+                       const char *body, size_t size)> handle);
+
+#endif /* _LISTENER_POOL_H_ */
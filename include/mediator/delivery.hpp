@@ -0,0 +1,155 @@
+#ifndef _MEDIATOR_DELIVERY_H_
+#define _MEDIATOR_DELIVERY_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "../shm_ring.hpp"
+
+/**
+ * @brief Delivery policy: every message published between two yields is
+ * published by the second, all at once, so readers are woken once per
+ * batch. If a whole ring's worth is queued it is published early. The
+ * default.
+ */
+struct Batched { };
+
+/**
+ * @brief Delivery policy for state topics, e.g. attitude: only the
+ * newest message published between two yields is published, and the
+ * rest are counted as coalesced.
+ */
+struct Latest { };
+
+/**
+ * @brief Delivery policy: at most `Depth` messages are queued between
+ * two yields; past that, the oldest queued message is dropped and
+ * counted.
+ */
+template <uint32_t Depth>
+struct DropOldest {
+    static_assert(Depth > 0, "DropOldest needs room for a message");
+};
+
+/** @brief The most messages a delivery policy queues; 0 if unbounded. */
+template <typename Delivery>
+struct delivery_depth {
+    static const uint32_t value = 0;
+};
+
+template <uint32_t Depth>
+struct delivery_depth<DropOldest<Depth> > {
+    static const uint32_t value = Depth;
+};
+
+/**
+ * @brief Counts what happened to the messages of an output topic, to
+ * size topics from real traffic.
+ */
+struct PublishStats {
+    /** Messages published to readers. */
+    uint64_t published;
+    /** Times queued messages were published. */
+    uint64_t batches;
+    /** Messages replaced by a newer one before being published. */
+    uint64_t coalesced;
+    /** Messages dropped from a full queue before being published. */
+    uint64_t dropped;
+};
+
+/**
+ * @brief Holds an output topic's messages between `publish_data` and
+ * `yield` according to its delivery policy.
+ */
+template <typename Data, typename Delivery>
+class TopicOutbox;
+
+/** Queues straight into the ring's claimed slots. */
+template <typename Data>
+class TopicOutbox<Data, Batched> {
+public:
+    void publish(ShmRingWriter<Data> *writer, const Data &data,
+                 PublishStats *stats) {
+        memcpy(writer->claim(), &data, sizeof(data));
+        if (writer->pending() == writer->capacity()) {
+            flush(writer, stats);
+        }
+    }
+
+    void flush(ShmRingWriter<Data> *writer, PublishStats *stats) {
+        if (writer->pending()) {
+            stats->published += writer->pending();
+            stats->batches++;
+            writer->commit();
+        }
+    }
+};
+
+/** Overwrites the one claimed slot in place. */
+template <typename Data>
+class TopicOutbox<Data, Latest> {
+public:
+    TopicOutbox(): claimed(NULL) { }
+
+    void publish(ShmRingWriter<Data> *writer, const Data &data,
+                 PublishStats *stats) {
+        if (writer->pending()) {
+            stats->coalesced++;
+        } else {
+            claimed = writer->claim();
+        }
+        memcpy(claimed, &data, sizeof(data));
+    }
+
+    void flush(ShmRingWriter<Data> *writer, PublishStats *stats) {
+        if (writer->pending()) {
+            stats->published++;
+            stats->batches++;
+            writer->commit();
+        }
+    }
+
+private:
+    Data *claimed;
+};
+
+/** Queues in a circular buffer outside the ring, since dropping the
+ *  oldest message would leave a hole in the ring's claimed slots. */
+template <typename Data, uint32_t Depth>
+class TopicOutbox<Data, DropOldest<Depth> > {
+public:
+    TopicOutbox(): first(0), count(0) { }
+
+    void publish(ShmRingWriter<Data> *, const Data &data,
+                 PublishStats *stats) {
+        if (count == Depth) {
+            first = (first + 1) % Depth;
+            count--;
+            stats->dropped++;
+        }
+        memcpy(&queue[(first + count) % Depth], &data, sizeof(data));
+        count++;
+    }
+
+    void flush(ShmRingWriter<Data> *writer, PublishStats *stats) {
+        if (!count) {
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(writer->claim(), &queue[(first + i) % Depth],
+                   sizeof(Data));
+        }
+        stats->published += count;
+        stats->batches++;
+        writer->commit();
+        first = 0;
+        count = 0;
+    }
+
+private:
+    Data queue[Depth];
+    uint32_t first;
+    uint32_t count;
+};
+
+#endif /* _MEDIATOR_DELIVERY_H_ */
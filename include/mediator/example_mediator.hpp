@@ -0,0 +1,24 @@
+#ifndef _EXAMPLE_MEDIATOR_H_
+#define _EXAMPLE_MEDIATOR_H_
+
+#include "mediator.hpp"
+
+/** The data the example module reads. */
+struct ExampleInData {
+    int x;
+};
+
+/** The data the example module publishes. */
+struct ExampleOutData {
+    char msg[64];
+};
+
+typedef Topic<topic_id("example.x"), ExampleInData> ExampleXTopic;
+typedef Topic<topic_id("example.msg"), ExampleOutData> ExampleMsgTopic;
+
+/** The specialized Mediator of the example module, as in
+ *  doc/mediator_readme.txt. */
+typedef Mediator<Inputs<ExampleXTopic>, Outputs<ExampleMsgTopic> >
+    ExampleMediator;
+
+#endif /* _EXAMPLE_MEDIATOR_H_ */
@@ -0,0 +1,415 @@
+#ifndef _MEDIATOR_H_
+#define _MEDIATOR_H_
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+
+#include "../heartbeat.hpp"
+#include "../shm_doorbell.hpp"
+#include "../shm_ring.hpp"
+#include "topic.hpp"
+
+/** How often a waiting Mediator looks for input topics that haven't
+ *  been published yet, which can't ring its doorbell. */
+const int MEDIATOR_OPEN_RETRY_MS = 100;
+
+/** The topics a Mediator reads. */
+template <typename... Topics> struct Inputs { };
+/** The topics a Mediator publishes. */
+template <typename... Topics> struct Outputs { };
+
+/** Stands in for `InData` or `OutData` when a Mediator doesn't have
+ *  exactly one input or output topic. */
+struct NoData { };
+
+/**
+ * @brief The data of a Mediator's only topic, for the single topic
+ * `get_data` and `publish_data`.
+ */
+template <typename... Topics>
+struct only_topic {
+    typedef NoData data_type;
+};
+
+template <typename Only>
+struct only_topic<Only> {
+    typedef Only type;
+    typedef typename Only::data_type data_type;
+};
+
+/** A Mediator's reader of one input topic. */
+template <typename Topic>
+struct TopicInput {
+    ShmRingReader<typename Topic::data_type> reader;
+    std::function<void(const typename Topic::data_type&)> handler;
+};
+
+/** A Mediator's writer of one output topic. */
+template <typename Topic>
+struct TopicOutput {
+    TopicOutput(): stats() { }
+
+    ShmRingWriter<typename Topic::data_type> writer;
+    TopicOutbox<typename Topic::data_type, typename Topic::delivery> outbox;
+    PublishStats stats;
+};
+
+/**
+ * @brief Get the memory key octopOS gave a module; modules are launched
+ * with it as their only argument.
+ *
+ * @param arg The module's argv[0].
+ * @return The module's memory key.
+ */
+inline MemKey module_memkey(const char *arg) {
+    return strtol(arg, NULL, 10);
+}
+
+template <typename InputList, typename OutputList> class Mediator;
+
+/**
+ * @brief Connects a module to the topics it reads and publishes. See
+ * doc/mediator_readme.txt.
+ *
+ * A team's specialized Mediator is an instantiation listing its topics,
+ * e.g.
+ *
+ *     typedef Mediator<Inputs<AttitudeTopic>,
+ *                      Outputs<TorqueTopic, HealthTopic> > ADCSMediator;
+ *
+ * Every topic is a ring in shared memory (see `ShmRingWriter`), and the
+ * Mediator holds one reader or writer per topic as a base class, so
+ * picking a topic's ring is resolved at compile time. `get_data` and
+ * `publish_data` copy the message once, to or from the ring, and never
+ * allocate.
+ *
+ * Instead of polling, a module can sleep in `wait` until an input has
+ * data, or register handlers with `on` and hand its thread to `run`.
+ * Publishers ring the module's doorbell (see `ShmDoorbell`) when they
+ * publish, so an idle module uses no CPU and is woken as soon as data
+ * arrives.
+ *
+ * `yield` and `wait` also beat the module's heartbeat (see `Heartbeat`),
+ * and `wait` wakes up in time to beat if the driver watches the module
+ * for hangs. A module that stops calling them is considered hung.
+ */
+template <typename... In, typename... Out>
+class Mediator<Inputs<In...>, Outputs<Out...> >
+    : private TopicInput<In>..., private TopicOutput<Out>... {
+    static_assert(distinct_topic_ids<In...>::value,
+                  "A Mediator's input topics must have distinct IDs");
+    static_assert(distinct_topic_ids<Out...>::value,
+                  "A Mediator's output topics must have distinct IDs");
+
+public:
+    /** The data of the only input topic. */
+    typedef typename only_topic<In...>::data_type InData;
+    /** The data of the only output topic. */
+    typedef typename only_topic<Out...>::data_type OutData;
+
+    /**
+     * @brief Create a Mediator. It must be initialized with `init`
+     * before use.
+     *
+     * @param key The module's memory key; see `module_memkey`.
+     * @return The Mediator.
+     */
+    static Mediator create(MemKey key) { return Mediator(key); }
+
+    /**
+     * @brief Open the rings of the output topics, and of the input
+     * topics that have been published to. Inputs published to later
+     * are opened by `yield`.
+     *
+     * @return Success status.
+     */
+    bool init() {
+        bool ok = true;
+        int expand[] = {0, (ok &= open_output<Out>(), 0)...};
+        (void)expand;
+        if (sizeof...(In) && !doorbell.create(key)) {
+            std::cerr << "Error: Unable to create doorbell "
+                      << shm_doorbell_name(key) << ": " << strerror(errno)
+                      << ". Waiting for data will poll." << std::endl;
+        }
+        open_inputs(false);
+        return ok;
+    }
+
+    /**
+     * @brief Publish the data queued with `publish_data`, and look for
+     * input topics that have started being published.
+     */
+    void yield() {
+        int expand[] = {0, (flush<Out>(), 0)...};
+        (void)expand;
+        open_inputs();
+        heartbeat.beat();
+    }
+
+    /**
+     * @brief Sleep until an input topic has data to get.
+     *
+     * @param timeout_ms The most milliseconds to wait; -1 for no limit.
+     * @return false if the wait timed out.
+     */
+    bool wait(int timeout_ms = -1) {
+        std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(timeout_ms);
+        while (1) {
+            heartbeat.beat();
+            open_inputs();
+            if (has_data()) {
+                return true;
+            }
+            int sleep_ms = -1;
+            if (timeout_ms >= 0) {
+                sleep_ms = std::chrono::duration_cast<
+                    std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                if (sleep_ms <= 0) {
+                    return false;
+                }
+            }
+            if (!doorbell.is_open() || !subscribed()) {
+                // Something can't ring us; look again every so often
+                if (sleep_ms < 0 || sleep_ms > MEDIATOR_OPEN_RETRY_MS) {
+                    sleep_ms = MEDIATOR_OPEN_RETRY_MS;
+                }
+            }
+            // Beat at least twice per deadline
+            int beat_ms = heartbeat.timeout_ms() / 2;
+            if (beat_ms > 0 && (sleep_ms < 0 || sleep_ms > beat_ms)) {
+                sleep_ms = beat_ms;
+            }
+            if (!doorbell.is_open()) {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(sleep_ms));
+                continue;
+            }
+            uint32_t seen = doorbell.prepare();
+            if (has_data()) {
+                doorbell.cancel();
+                return true;
+            }
+            doorbell.sleep(seen, sleep_ms);
+        }
+    }
+
+    /**
+     * @brief Call `handler` with each message of an input topic, from
+     * `dispatch`. Topics with a handler shouldn't also be read with
+     * `get_data`.
+     *
+     * @tparam Topic The topic.
+     * @param handler The handler.
+     */
+    template <typename Topic>
+    void on(std::function<void(const typename Topic::data_type&)> handler) {
+        input<Topic>().handler = handler;
+    }
+
+    /**
+     * @brief Call the handlers of the messages available now. Each
+     * topic's handler is called at most the topic's capacity times, so a
+     * busy topic can't starve the others.
+     *
+     * @return The number of messages handled.
+     */
+    size_t dispatch() {
+        size_t handled = 0;
+        int expand[] = {0, (handled += dispatch_topic<In>(), 0)...};
+        (void)expand;
+        return handled;
+    }
+
+    /**
+     * @brief Handle messages and publish as they arrive, until `stop`.
+     * Every input topic should have a handler.
+     */
+    void run() {
+        running = true;
+        while (running) {
+            dispatch();
+            yield();
+            if (running) {
+                wait();
+            }
+        }
+    }
+
+    /** Make `run` return, e.g. from a handler. */
+    void stop() { running = false; }
+
+    /**
+     * @brief Get the next message of an input topic.
+     *
+     * @tparam Topic The topic.
+     * @param data Where to copy the message.
+     * @return 1 if a message was read, 0 if none is available and `data`
+     * is unmodified.
+     */
+    template <typename Topic>
+    int get_data(typename Topic::data_type *data) {
+        return input<Topic>().reader.read(data);
+    }
+
+    /**
+     * @brief Get the next message of the only input topic.
+     *
+     * @param data Where to copy the message.
+     * @return 1 if a message was read, 0 if none is available.
+     */
+    int get_data(InData *data) {
+        static_assert(sizeof...(In) == 1, "Name the topic to get data from "
+                      "with get_data<Topic>");
+        return get_data<typename only_topic<In...>::type>(data);
+    }
+
+    /**
+     * @brief Queue a message on an output topic, to be published on the
+     * next `yield` according to the topic's delivery policy (see
+     * `Batched`, `Latest` and `DropOldest`).
+     *
+     * @tparam Topic The topic.
+     * @param data The message.
+     */
+    template <typename Topic>
+    void publish_data(const typename Topic::data_type &data) {
+        TopicOutput<Topic> &out = output<Topic>();
+        if (out.writer.is_open()) {
+            out.outbox.publish(&out.writer, data, &out.stats);
+        }
+    }
+
+    /**
+     * @brief Queue a message on the only output topic.
+     *
+     * @param data The message.
+     */
+    void publish_data(const OutData &data) {
+        static_assert(sizeof...(Out) == 1, "Name the topic to publish to "
+                      "with publish_data<Topic>");
+        publish_data<typename only_topic<Out...>::type>(data);
+    }
+
+    /**
+     * @tparam Topic An output topic.
+     * @return What happened to the topic's messages so far.
+     */
+    template <typename Topic>
+    const PublishStats& stats() {
+        return output<Topic>().stats;
+    }
+
+    /**
+     * @tparam Topic An input topic.
+     * @return The number of the topic's messages that were overwritten
+     * before this Mediator got to them.
+     */
+    template <typename Topic>
+    uint64_t dropped() {
+        return input<Topic>().reader.dropped();
+    }
+
+private:
+    MemKey key;
+    ShmDoorbell doorbell;
+    Heartbeat heartbeat;
+    bool running;
+
+    explicit Mediator(MemKey _key):
+        key(_key), heartbeat(_key), running(false) { }
+
+    template <typename Topic>
+    TopicInput<Topic>& input() {
+        static_assert(std::is_base_of<TopicInput<Topic>, Mediator>::value,
+                      "Not an input topic of this Mediator");
+        return *this;
+    }
+
+    template <typename Topic>
+    TopicOutput<Topic>& output() {
+        static_assert(std::is_base_of<TopicOutput<Topic>, Mediator>::value,
+                      "Not an output topic of this Mediator");
+        return *this;
+    }
+
+    template <typename Topic>
+    void flush() {
+        TopicOutput<Topic> &out = output<Topic>();
+        if (out.writer.is_open()) {
+            out.outbox.flush(&out.writer, &out.stats);
+        }
+    }
+
+    template <typename Topic>
+    bool open_output() {
+        if (!output<Topic>().writer.open(topic_ring_name(Topic::id),
+                                         Topic::capacity, key)) {
+            std::cerr << "Error: Unable to open topic "
+                      << topic_ring_name(Topic::id) << " for publishing: "
+                      << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Topic>
+    int open_input(bool from_oldest) {
+        ShmRingReader<typename Topic::data_type> &reader =
+            input<Topic>().reader;
+        if (!reader.is_open() &&
+            reader.open(topic_ring_name(Topic::id), from_oldest) &&
+            doorbell.is_open() && !reader.subscribe(key)) {
+            std::cerr << "Error: Too many subscribers to topic "
+                      << topic_ring_name(Topic::id)
+                      << ". Waiting for it will poll." << std::endl;
+        }
+        return 0;
+    }
+
+    /** A topic first published after `init` is read from its oldest
+     *  message, since every message in it is new to this module. */
+    void open_inputs(bool from_oldest = true) {
+        int expand[] = {0, open_input<In>(from_oldest)...};
+        (void)expand;
+    }
+
+    bool has_data() {
+        bool any = false;
+        int expand[] = {0, (any |= input<In>().reader.available() != 0, 0)...};
+        (void)expand;
+        return any;
+    }
+
+    bool subscribed() {
+        bool all = true;
+        int expand[] = {0, (all &= input<In>().reader.subscribed(), 0)...};
+        (void)expand;
+        return all;
+    }
+
+    template <typename Topic>
+    size_t dispatch_topic() {
+        TopicInput<Topic> &in = input<Topic>();
+        if (!in.handler) {
+            return 0;
+        }
+        typename Topic::data_type data;
+        size_t handled = 0;
+        while (handled < Topic::capacity && in.reader.read(&data)) {
+            in.handler(data);
+            handled++;
+        }
+        return handled;
+    }
+};
+
+#endif /* _MEDIATOR_H_ */
@@ -0,0 +1,94 @@
+#ifndef _MEDIATOR_TOPIC_H_
+#define _MEDIATOR_TOPIC_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+#include "delivery.hpp"
+
+/**
+ * @brief Compute a topic's ID from its name at compile time (FNV-1a),
+ * e.g. `topic_id("attitude")`.
+ *
+ * @param name The topic's name.
+ * @param hash The hash of the preceding characters.
+ * @return The topic's ID.
+ */
+constexpr uint32_t topic_id(const char *name, uint32_t hash = 2166136261u) {
+    return *name ? topic_id(name + 1, (hash ^ (uint8_t)*name) * 16777619u)
+        : hash;
+}
+
+/**
+ * @brief Describes a topic at compile time: its ID, the layout of its
+ * messages, how many messages its ring keeps and how messages published
+ * between yields are delivered.
+ *
+ * @tparam ID The topic's ID; see `topic_id`.
+ * @tparam Data The message struct. It is copied as raw bytes between
+ * modules, so it must be trivially copyable: fixed size arrays instead
+ * of std::string or std::vector, and no pointers.
+ * @tparam Capacity The number of messages kept for slow readers, and the
+ * most that can be published between yields without being flushed
+ * early. A power of 2.
+ * @tparam Delivery The delivery policy: `Batched`, `Latest` or
+ * `DropOldest<Depth>`.
+ */
+template <uint32_t ID, typename Data, uint32_t Capacity = 64,
+          typename Delivery = Batched>
+struct Topic {
+    static_assert(std::is_trivially_copyable<Data>::value,
+                  "Topic data must be trivially copyable");
+    static_assert(Capacity && !(Capacity & (Capacity - 1)),
+                  "Topic capacity must be a power of 2");
+    static_assert(delivery_depth<Delivery>::value <= Capacity,
+                  "A topic can't queue more messages than its ring keeps");
+
+    typedef Data data_type;
+    typedef Delivery delivery;
+    static constexpr uint32_t id = ID;
+    static constexpr uint32_t capacity = Capacity;
+};
+
+template <uint32_t ID, typename Data, uint32_t Capacity, typename Delivery>
+constexpr uint32_t Topic<ID, Data, Capacity, Delivery>::id;
+template <uint32_t ID, typename Data, uint32_t Capacity, typename Delivery>
+constexpr uint32_t Topic<ID, Data, Capacity, Delivery>::capacity;
+
+/**
+ * @brief Whether any of `Topics` has the given ID.
+ */
+template <uint32_t ID, typename... Topics>
+struct has_topic_id : std::false_type { };
+
+template <uint32_t ID, typename First, typename... Rest>
+struct has_topic_id<ID, First, Rest...>
+    : std::integral_constant<bool, First::id == ID ||
+                             has_topic_id<ID, Rest...>::value> { };
+
+/**
+ * @brief Whether no two of `Topics` share an ID.
+ */
+template <typename... Topics>
+struct distinct_topic_ids : std::true_type { };
+
+template <typename First, typename... Rest>
+struct distinct_topic_ids<First, Rest...>
+    : std::integral_constant<bool, !has_topic_id<First::id, Rest...>::value &&
+                             distinct_topic_ids<Rest...>::value> { };
+
+/**
+ * @brief Get the name of a topic's ring; see `shm_ring_name`.
+ *
+ * @param id The topic's ID.
+ * @return The ring's topic name.
+ */
+inline std::string topic_ring_name(uint32_t id) {
+    char name[16];
+    snprintf(name, sizeof(name), "topic.%08x", id);
+    return name;
+}
+
+#endif /* _MEDIATOR_TOPIC_H_ */
@@ -0,0 +1,143 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "module_registry.hpp"
+
+/** Values below `2^HISTOGRAM_SUB_BUCKET_BITS` are counted exactly;
+ *  larger ones with a relative error of at most
+ *  `2^-HISTOGRAM_SUB_BUCKET_BITS`. */
+const int HISTOGRAM_SUB_BUCKET_BITS = 3;
+/** The number of buckets needed to cover every 64 bit value. */
+const size_t HISTOGRAM_BUCKETS =
+    (64 - HISTOGRAM_SUB_BUCKET_BITS + 1) << HISTOGRAM_SUB_BUCKET_BITS;
+
+/** @return The monotonic clock in microseconds, for timing latencies. */
+int64_t metrics_now_us();
+
+/** A count that only goes up. Safe to update from any thread. */
+class Counter {
+public:
+    Counter(): value(0) { }
+
+    /** Add `n` to the count. */
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+
+    /** @return The count. */
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+/**
+ * @brief A histogram of latencies in the style of HdrHistogram: buckets
+ * are log-linear, so that a fixed number of them covers every value
+ * with bounded relative error, and recording is a few relaxed atomic
+ * adds. Safe to record to from any thread.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    /**
+     * @brief Record one latency.
+     *
+     * @param us The latency in microseconds. Negative values, from a
+     * clock going backwards, count as 0.
+     */
+    void record(int64_t us);
+
+    /** @return The number of latencies recorded. */
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+
+    /** @return The sum of the latencies recorded, in microseconds. */
+    uint64_t sum() const { return sum_us.load(std::memory_order_relaxed); }
+
+    /** @return The largest latency recorded, in microseconds. */
+    uint64_t max() const { return max_us.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Estimate a quantile of the recorded latencies.
+     *
+     * @param q The quantile, from 0 to 1.
+     * @return The upper bound of the bucket holding the quantile, in
+     * microseconds, or 0 if nothing was recorded.
+     */
+    uint64_t quantile(double q) const;
+
+    /** @return The bucket counting `value`. */
+    static size_t bucket_of(uint64_t value);
+
+    /** @return The largest value counted by `bucket`. */
+    static uint64_t upper_bound_of(size_t bucket);
+
+private:
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum_us;
+    std::atomic<uint64_t> max_us;
+
+    LatencyHistogram(const LatencyHistogram&);
+    LatencyHistogram& operator=(const LatencyHistogram&);
+};
+
+/** The driver's counters and latency histograms. */
+struct SupervisorMetrics {
+    /** Modules started by `spawn_module`. */
+    Counter spawns;
+    /** Modules `spawn_module` couldn't start. */
+    Counter spawn_failures;
+    /** Relaunches of modules that died or were upgraded. */
+    Counter restarts;
+    /** Deaths of modules. */
+    Counter deaths;
+    /** Deaths of children that aren't modules. */
+    Counter unknown_deaths;
+    /** Restarts delayed by backoff. */
+    Counter backoffs;
+    /** Downgrades requested. */
+    Counter downgrades;
+    /** Upgrade requests received by the listener. */
+    Counter upgrade_requests;
+    /** Upgrades started. */
+    Counter upgrades;
+    /** Modules killed for missing their heartbeat deadline. */
+    Counter hangs;
+    /** Tentacle listener threads started. They run until the driver
+     *  exits, each blocked on its tentacle. */
+    Counter listeners;
+
+    /** How long one `spawn_module` takes. */
+    LatencyHistogram spawn_us;
+    /** How long a module that died stays down until it is running
+     *  again, backoff included. */
+    LatencyHistogram downtime_us;
+    /** How long one pass of `reboot_dead_modules` takes. */
+    LatencyHistogram reap_us;
+    /** How long an upgrade request waits for the babysitting loop. */
+    LatencyHistogram upgrade_wait_us;
+    /** How long handling one batch of upgrade requests takes. */
+    LatencyHistogram upgrade_us;
+};
+
+/** @return The driver's metrics. */
+SupervisorMetrics& supervisor_metrics();
+
+/**
+ * @brief Write metrics in the Prometheus text format. Histograms are
+ * written as summaries, in seconds.
+ *
+ * @param out The stream to write to.
+ * @param metrics The metrics.
+ * @param modules The managed modules, for gauges of their state, if any.
+ */
+void write_metrics(std::ostream &out, const SupervisorMetrics &metrics,
+                   const ModuleRegistry *modules);
+
+#endif /* _METRICS_H_ */
@@ -0,0 +1,54 @@
+#ifndef _METRICS_SERVER_H_
+#define _METRICS_SERVER_H_
+
+#include "event_loop.hpp"
+#include "metrics.hpp"
+#include "module_registry.hpp"
+
+/** Where the driver serves its metrics unless the config's
+ *  `metrics_socket` says otherwise. */
+extern const char* METRICS_SOCKET_PATH;
+
+/**
+ * @brief Serves `supervisor_metrics` on a Unix domain socket from the
+ * babysitting loop, so that a running driver can be profiled without
+ * attaching a debugger. Each connection is sent the metrics in the
+ * Prometheus text format and closed, e.g.
+ *
+ *     socat - UNIX-CONNECT:/run/octopOS/metrics.sock
+ */
+class MetricsServer {
+public:
+    /**
+     * @brief Create a server. Nothing is served until `start`.
+     *
+     * @param loop The babysitting loop.
+     * @param modules The managed modules.
+     */
+    MetricsServer(EventLoop *loop, const ModuleRegistry *modules);
+
+    /** Stops serving and removes the socket. */
+    ~MetricsServer();
+
+    /**
+     * @brief Listen on a socket, replacing any left by an earlier
+     * driver.
+     *
+     * @param path The socket's path.
+     * @return Success status.
+     */
+    bool start(const FilePath &path = METRICS_SOCKET_PATH);
+
+private:
+    EventLoop *loop;
+    const ModuleRegistry *modules;
+    FilePath path;
+    int listen_fd;
+
+    void serve();
+
+    MetricsServer(const MetricsServer&);
+    MetricsServer& operator=(const MetricsServer&);
+};
+
+#endif /* _METRICS_SERVER_H_ */
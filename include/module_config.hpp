@@ -0,0 +1,202 @@
+#ifndef _MODULE_CONFIG_H_
+#define _MODULE_CONFIG_H_
+
+#include <ctime>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+/** The minimum number of seconds of runtime before death for modules.
+ *  Modules that die in less than this amount of time will be marked
+ *  as having died "suspiciously". This is the default for
+ *  `RestartPolicy::runtime_cutoff_s`.
+ */
+extern const time_t RUNTIME_CUTOFF_DOWNGRADE_S;
+/** The maximum number of times in a row that a module can die
+ *  "suspiciously" before being downgraded. This is the default for
+ *  `RestartPolicy::death_count_cutoff`.
+ *  See `RUNTIME_CUTOFF_DOWNGRADE_S`.
+ */
+extern const int    DEATH_COUNT_CUTOFF_DOWNGRADE;
+
+/**
+ * @brief How a module is restarted after it dies.
+ *
+ * The first restart after a suspicious death is always immediate, so
+ * a module that crashes once comes back as fast as possible. Every
+ * further suspicious death in a row waits longer: `initial_delay_ms`,
+ * then that times `multiplier` per death, up to `max_delay_ms`, each
+ * varied randomly by up to +/- `jitter` so that modules that died
+ * together don't restart together. Intentional and unsuspicious deaths
+ * are always restarted immediately.
+ */
+struct RestartPolicy {
+    /** The delay before the second restart in a row. */
+    int64_t initial_delay_ms;
+    /** The factor by which each further delay grows. */
+    double multiplier;
+    /** The random variation of each delay, as a fraction of it. */
+    double jitter;
+    /** The longest delay between restarts. */
+    int64_t max_delay_ms;
+    /** See `RUNTIME_CUTOFF_DOWNGRADE_S`. */
+    time_t runtime_cutoff_s;
+    /** See `DEATH_COUNT_CUTOFF_DOWNGRADE`. */
+    int death_count_cutoff;
+
+    /** Construct the default policy. */
+    RestartPolicy();
+
+    bool operator==(const RestartPolicy &other) const;
+    bool operator!=(const RestartPolicy &other) const {
+        return !(*this == other);
+    }
+};
+
+/** The time a watched module has after being launched before it must
+ *  start beating. This is the default for
+ *  `WatchdogPolicy::startup_grace_ms`.
+ */
+extern const int64_t WATCHDOG_STARTUP_GRACE_MS;
+
+/**
+ * @brief How a module's heartbeat is watched (see `Watchdog`). A module
+ * that doesn't beat for `timeout_ms` is considered hung and is killed,
+ * which counts as a suspicious death (see `module_needs_downgrade`).
+ */
+struct WatchdogPolicy {
+    /** The longest a module may go without beating; 0, the default,
+     *  to not watch it. */
+    int64_t timeout_ms;
+    /** See `WATCHDOG_STARTUP_GRACE_MS`. */
+    int64_t startup_grace_ms;
+
+    /** Construct the default policy. */
+    WatchdogPolicy();
+
+    bool operator==(const WatchdogPolicy &other) const {
+        return timeout_ms == other.timeout_ms &&
+            startup_grace_ms == other.startup_grace_ms;
+    }
+    bool operator!=(const WatchdogPolicy &other) const {
+        return !(*this == other);
+    }
+};
+
+/** The cgroup v2 directory under which modules get their own cgroup.
+ *  This is the default for `ResourcePolicy::cgroup_root`. It must be
+ *  delegated to the driver, and the driver must not run in it. */
+extern const char* CGROUP_ROOT;
+
+/**
+ * @brief The resources a module may use, so that one runaway module
+ * can't starve the others or the driver.
+ *
+ * A module with a CPU, memory or CPU set limit is started in its own
+ * cgroup under `cgroup_root`, which enforces them. Niceness, I/O
+ * priority and CPU affinity are set on the module's process before it
+ * execs. The default is no limits.
+ */
+struct ResourcePolicy {
+    /** The most CPU time the module may use, in percent of one CPU
+     *  (cgroup `cpu.max`); 0 for no limit. */
+    double cpu_max_percent;
+    /** The most memory the module may use (cgroup `memory.max`); 0 for
+     *  no limit. */
+    int64_t memory_max_kb;
+    /** The CPUs the module may run on (cgroup `cpuset.cpus` and its
+     *  affinity); empty for any. */
+    std::vector<int> cpus;
+    /** The module's niceness; 0 to inherit the driver's. */
+    int nice;
+    /** The module's I/O scheduling class: "realtime", "best-effort" or
+     *  "idle"; empty to inherit the driver's. */
+    std::string io_class;
+    /** The module's priority within `io_class`, from 0 (highest) to 7. */
+    int io_priority;
+    /** See `CGROUP_ROOT`. */
+    std::string cgroup_root;
+
+    /** Construct the default policy. */
+    ResourcePolicy();
+
+    /** @return Whether the module needs its own cgroup. */
+    bool needs_cgroup() const {
+        return cpu_max_percent > 0 || memory_max_kb > 0 || !cpus.empty();
+    }
+
+    bool operator==(const ResourcePolicy &other) const;
+    bool operator!=(const ResourcePolicy &other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * @brief Per-module settings from the octopOS config.
+ *
+ * Settings are read from the config's `module_defaults` object and
+ * then from the module's entry, named after its executable, in the
+ * `modules` object; each setting that is present overrides the
+ * previous one. For example:
+ *
+ *     {
+ *         "modules_enabled": "/usr/local/lib/octopOS/modules",
+ *         "module_defaults": {
+ *             "restart": {"initial_delay_ms": 100, "max_delay_ms": 60000}
+ *         },
+ *         "modules": {
+ *             "gps": {
+ *                 "restart": {"multiplier": 4, "jitter": 0.1,
+ *                             "runtime_cutoff_s": 60,
+ *                             "death_count_cutoff": 3},
+ *                 "watchdog": {"timeout_ms": 2000,
+ *                              "startup_grace_ms": 5000},
+ *                 "resources": {"cpu_max_percent": 50,
+ *                               "memory_max_kb": 65536, "cpus": [1],
+ *                               "nice": 5, "io_class": "best-effort",
+ *                               "io_priority": 6}
+ *             }
+ *         }
+ *     }
+ */
+struct ModuleConfig {
+    /** See `RestartPolicy`. */
+    RestartPolicy restart;
+    /** See `WatchdogPolicy`. */
+    WatchdogPolicy watchdog;
+    /** See `ResourcePolicy`. */
+    ResourcePolicy resources;
+
+    bool operator==(const ModuleConfig &other) const {
+        return restart == other.restart && watchdog == other.watchdog &&
+            resources == other.resources;
+    }
+    bool operator!=(const ModuleConfig &other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * @brief Get the settings of the given module from the given config.
+ *
+ * @param config The parsed octopOS config.
+ * @param module The path of the module executable.
+ * @return The module's settings; defaults for anything not configured.
+ */
+ModuleConfig module_config_for(const json &config, const std::string &module);
+
+/**
+ * @brief Compute how long to wait before restarting a module.
+ *
+ * @param policy The module's restart policy.
+ * @param early_death_count The module's number of suspicious deaths in
+ * a row, including the one being handled.
+ * @param random_unit A random number in [0, 1) used for jitter.
+ * @return The delay in milliseconds; 0 to restart immediately.
+ */
+int64_t restart_delay_ms(const RestartPolicy &policy, int early_death_count,
+                         double random_unit);
+
+#endif /* _MODULE_CONFIG_H_ */
@@ -0,0 +1,246 @@
+#ifndef _MODULE_REGISTRY_H_
+#define _MODULE_REGISTRY_H_
+
+#include <string>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+#include "Optional.hpp"
+#include "module_config.hpp"
+
+typedef long MemKey;
+typedef std::string FilePath;
+
+/** The number of terminating signals remembered for each module. */
+const int SIGNAL_HISTORY_LENGTH = 8;
+
+/** The structure containing all significant information about managed
+ *  modules.
+ */
+struct Module {
+    /** The PID of the module process. */
+    pid_t pid;
+    /** The ID of the tentacle assigned to the module. */
+    int tentacle_id;
+    /** The time that the module was launched. This is used to
+     *  calculate running time when the module dies.
+     */
+    time_t launch_time;
+    /** Whether the module has been intentionally killed */
+    bool killed;
+    /** Whether the module has been requested to be downgraded */
+    bool downgrade_requested;
+    /** Whether the module has been removed from the enabled modules.
+     *  Retired modules are never relaunched, but keep their slot and
+     *  tentacle in case they are enabled again.
+     */
+    bool retired;
+    /** The number of early/"suspicious" _sequential_ deaths of the module. */
+    int early_death_count;
+    /** The errno of the last launch attempt if the module never
+     *  started (e.g. its executable is missing or corrupt), or 0 if it
+     *  did. A module that never started has no process to die, so this
+     *  is distinct from a crash.
+     */
+    int launch_error;
+    /** The number of times the module has died. */
+    int death_count;
+    /** The raw wait status of the module's last death (see `wait4`).
+     *  Only meaningful if `death_count` > 0.
+     */
+    int last_status;
+    /** The CPU time (user + system) used by the module's last run. */
+    long last_cpu_time_us;
+    /** The CPU time (user + system) used by all runs of the module. */
+    long cpu_time_us;
+    /** The largest resident set size of any run of the module. */
+    long max_rss_kb;
+    /** The number of times the module was killed for missing its
+     *  heartbeat deadline (see `Watchdog`). */
+    int hang_count;
+    /** When the module last died, on the `metrics_now_us` clock, or 0
+     *  if it has been running since. */
+    int64_t died_at_us;
+    /** The number of times the module has been killed by a signal. */
+    int signal_death_count;
+    /** The most recent signals that killed the module, oldest first once
+     *  full. Signal `i` is at index `i % SIGNAL_HISTORY_LENGTH`.
+     */
+    int signal_history[SIGNAL_HISTORY_LENGTH];
+    /** The module's settings from the octopOS config. */
+    ModuleConfig config;
+    /** The cgroup the module was last started in, or empty if it runs
+     *  in the driver's (see `ResourcePolicy`). */
+    FilePath cgroup;
+    /**
+     * Module constructor.
+     * @param _pid
+     * @param _tentacle_id
+     * @param _launch_time
+     * @return A new Module
+     */
+    Module(pid_t _pid, int _tentacle_id, time_t _launch_time):
+        pid(_pid), tentacle_id(_tentacle_id), launch_time(_launch_time),
+        killed(false), downgrade_requested(false), retired(false),
+        early_death_count(0), launch_error(0), death_count(0),
+        last_status(0), last_cpu_time_us(0), cpu_time_us(0), max_rss_kb(0),
+        hang_count(0), died_at_us(0), signal_death_count(0),
+        signal_history() { }
+    /**
+     * Module default constructor. Just here to be able to put them in
+     * containers. Use the real constructor in your code instead.
+     * @return A new Module
+     */
+    Module(): pid(-1), tentacle_id(-1), launch_time(0),
+              killed(false), downgrade_requested(false), retired(false),
+              early_death_count(0), launch_error(0), death_count(0),
+              last_status(0), last_cpu_time_us(0), cpu_time_us(0),
+              max_rss_kb(0), hang_count(0), died_at_us(0),
+              signal_death_count(0),
+              signal_history() { }
+};
+
+/** The index of a module in a `ModuleRegistry`. Slots are never reused
+ *  or moved, so they stay valid for the lifetime of the registry.
+ */
+typedef size_t ModuleSlot;
+
+/**
+ * @brief The set of managed modules.
+ *
+ * Modules are stored contiguously and addressed by slot. Paths are
+ * interned to a slot once, and a PID index maps live PIDs back to
+ * their slot so that reaping a child costs O(1) instead of a scan
+ * over every module.
+ *
+ * Whenever a module's `pid` changes, call `reindex` with its slot.
+ * Lookups are still correct if that is forgotten (a stale index entry
+ * falls back to a scan that repairs it), just slower.
+ *
+ * *References returned by `operator[]` and `at` are invalidated by
+ * adding new modules.*
+ */
+class ModuleRegistry {
+public:
+    /** Iterator over (path, module) pairs in slot order. */
+    template <typename Registry, typename M>
+    class Iterator {
+    public:
+        Iterator(Registry *_registry, ModuleSlot _slot):
+            registry(_registry), slot(_slot) { }
+        std::pair<const FilePath&, M&> operator*() const {
+            return std::pair<const FilePath&, M&>(registry->path_of(slot),
+                                                  registry->at(slot));
+        }
+        Iterator& operator++() { ++slot; return *this; }
+        bool operator==(const Iterator &other) const {
+            return slot == other.slot;
+        }
+        bool operator!=(const Iterator &other) const {
+            return slot != other.slot;
+        }
+
+    private:
+        Registry *registry;
+        ModuleSlot slot;
+    };
+    typedef Iterator<ModuleRegistry, Module> iterator;
+    typedef Iterator<const ModuleRegistry, const Module> const_iterator;
+
+    ModuleRegistry() { }
+
+    /**
+     * @brief Construct a registry holding the given modules.
+     *
+     * @param init (path, module) pairs.
+     */
+    ModuleRegistry(std::initializer_list< std::pair<FilePath, Module> > init);
+
+    /**
+     * @brief Add or replace the module at the given path.
+     *
+     * @param path The module's executable path.
+     * @param module The module.
+     * @return The module's slot.
+     */
+    ModuleSlot add(const FilePath &path, const Module &module);
+
+    /**
+     * @brief Get the slot of the module at the given path, adding a
+     * default module if there is none yet.
+     *
+     * @param path The module's executable path.
+     * @return The module's slot.
+     */
+    ModuleSlot intern(const FilePath &path);
+
+    /**
+     * @brief Get the module at the given path, adding a default one if
+     * there is none yet.
+     *
+     * @param path The module's executable path.
+     * @return A reference to the module.
+     */
+    Module& operator[](const FilePath &path);
+
+    /**
+     * @brief Get the slot of the module at the given path.
+     *
+     * @param path The module's executable path.
+     * @return The slot, if the path is registered.
+     */
+    CDH::Optional<ModuleSlot> slot_of(const FilePath &path) const;
+
+    /**
+     * @brief Get the slot of the module with the given PID.
+     *
+     * @param pid
+     * @return The slot, if a module with that PID is registered.
+     */
+    CDH::Optional<ModuleSlot> slot_with(pid_t pid) const;
+
+    /**
+     * @brief Update the PID index after the module in `slot` changed
+     * its `pid`.
+     *
+     * @param slot
+     */
+    void reindex(ModuleSlot slot);
+
+    /** @return The module in the given slot. */
+    Module& at(ModuleSlot slot) { return modules[slot]; }
+    /** @return The module in the given slot. */
+    const Module& at(ModuleSlot slot) const { return modules[slot]; }
+    /** @return The executable path of the module in the given slot. */
+    const FilePath& path_of(ModuleSlot slot) const { return paths[slot]; }
+
+    /** @return The number of registered modules. */
+    size_t size() const { return modules.size(); }
+    /** @return The number of modules registered at `path` (0 or 1). */
+    size_t count(const FilePath &path) const { return by_path.count(path); }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, modules.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, modules.size()); }
+
+private:
+    /** Module table, indexed by slot. */
+    std::vector<Module> modules;
+    /** Executable paths, indexed by slot. */
+    std::vector<FilePath> paths;
+    /** The PID each slot was last indexed under, indexed by slot. */
+    mutable std::vector<pid_t> indexed_pids;
+    std::unordered_map<FilePath, ModuleSlot> by_path;
+    mutable std::unordered_map<pid_t, ModuleSlot> by_pid;
+
+    void update_pid_index(ModuleSlot slot) const;
+};
+
+#endif /* _MODULE_REGISTRY_H_ */
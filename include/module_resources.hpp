@@ -0,0 +1,74 @@
+#ifndef _MODULE_RESOURCES_H_
+#define _MODULE_RESOURCES_H_
+
+#include <cstdint>
+
+#include "Optional.hpp"
+#include "module_config.hpp"
+#include "module_registry.hpp"
+#include "module_spawner.hpp"
+
+/** The period of the CPU limits written to `cpu.max`. */
+extern const int64_t CGROUP_CPU_PERIOD_US;
+
+/** What a cgroup has used, from its `cpu.stat`, `memory.current` and
+ *  `memory.events`. */
+struct CgroupUsage {
+    /** CPU time used, in microseconds. */
+    uint64_t cpu_usage_us;
+    /** Time spent throttled by `cpu.max`, in microseconds. */
+    uint64_t cpu_throttled_us;
+    /** Memory in use, in bytes. */
+    uint64_t memory_bytes;
+    /** Processes killed for exceeding `memory.max`. */
+    uint64_t oom_kills;
+};
+
+/**
+ * @brief Get the cgroup a module is started in.
+ *
+ * @param module The path of the module executable.
+ * @param policy The module's resource policy.
+ * @return The cgroup's directory, under `policy.cgroup_root`.
+ */
+FilePath module_cgroup_path(const FilePath &module,
+                            const ResourcePolicy &policy);
+
+/**
+ * @brief Create a module's cgroup if needed, enabling the controllers
+ * it needs in `policy.cgroup_root`, and write its limits.
+ *
+ * @param cgroup The module's cgroup (see `module_cgroup_path`).
+ * @param policy The module's resource policy.
+ * @return Success status.
+ */
+bool prepare_module_cgroup(const FilePath &cgroup,
+                           const ResourcePolicy &policy);
+
+/**
+ * @brief Remove a module's cgroup. Only works once the module is dead.
+ *
+ * @param cgroup The module's cgroup.
+ */
+void remove_module_cgroup(const FilePath &cgroup);
+
+/**
+ * @brief Get the spawn options of a module, preparing its cgroup if it
+ * needs one. Invalid settings are reported and left out.
+ *
+ * @param module The path of the module executable.
+ * @param policy The module's resource policy.
+ * @return The options to spawn the module with.
+ */
+SpawnOptions spawn_options_for(const FilePath &module,
+                               const ResourcePolicy &policy);
+
+/**
+ * @brief Read what a cgroup has used.
+ *
+ * @param cgroup The cgroup's directory.
+ * @return The usage, if the cgroup's files can be read.
+ */
+CDH::Optional<CgroupUsage> read_cgroup_usage(const FilePath &cgroup);
+
+#endif /* _MODULE_RESOURCES_H_ */
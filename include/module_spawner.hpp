@@ -0,0 +1,111 @@
+#ifndef _MODULE_SPAWNER_H_
+#define _MODULE_SPAWNER_H_
+
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+#include "module_registry.hpp"
+
+/** A module executable and the memory key to launch it with. */
+typedef std::pair<FilePath, MemKey> SpawnRequest;
+
+/** How to start a module process, beyond what `posix_spawn` can do. */
+struct SpawnOptions {
+    /** The cgroup v2 directory to start the module in; empty for the
+     *  driver's. */
+    FilePath cgroup;
+    /** The module's niceness; 0 to inherit the driver's. */
+    int nice;
+    /** The module's I/O priority, as given to `ioprio_set`; 0 to
+     *  inherit the driver's. */
+    int ioprio;
+    /** The CPUs the module may run on; empty for any. */
+    std::vector<int> cpus;
+
+    SpawnOptions(): nice(0), ioprio(0) { }
+
+    /** @return Whether a plain `posix_spawn` starts the module. */
+    bool is_default() const {
+        return cgroup.empty() && nice == 0 && ioprio == 0 && cpus.empty();
+    }
+};
+
+/** The outcome of spawning one module. */
+struct SpawnResult {
+    /** The PID of the new module, or -1 if it couldn't be started. */
+    pid_t pid;
+    /** The errno of the failed spawn or exec, or 0 on success. */
+    int error;
+};
+
+/**
+ * @brief Spawn the given module executable with the given memory key
+ * as its only argument (argv[0]).
+ *
+ * Uses `posix_spawn`, which on Linux creates the child with
+ * `clone(CLONE_VM | CLONE_VFORK)`: no page tables are copied and no
+ * code runs in the child between clone and exec, so it is cheap even
+ * when the driver is large and safe while other threads hold locks.
+ * The child starts with SIGCHLD unblocked and default signal handlers.
+ *
+ * Exec failures are reported to the parent (glibc passes the child's
+ * exec errno back before `posix_spawn` returns), so a missing or
+ * corrupt executable never produces a child that dies immediately.
+ *
+ * @param module The path to the module executable.
+ * @param key The memory key to provide the module.
+ * @return The PID of the new module, or -1 with errno set if it
+ * couldn't be started.
+ */
+pid_t spawn_module(const FilePath &module, MemKey key);
+
+/**
+ * @brief Spawn the given module executable with the given memory key,
+ * applying `options` before it execs.
+ *
+ * Modules with default options are started by `posix_spawn`. Others
+ * are cloned: with `clone3(CLONE_INTO_CGROUP)` the module starts in its
+ * cgroup, and on kernels without it (before 5.7) the child moves itself
+ * there before doing anything else. Either way the module never runs
+ * outside its cgroup. The child then sets its niceness, I/O priority
+ * and affinity and execs. If any of that fails the module isn't
+ * started, and the error is reported as for a failed exec.
+ *
+ * @param module The path to the module executable.
+ * @param key The memory key to provide the module.
+ * @param options How to start the module.
+ * @return The PID of the new module, or -1 with errno set if it
+ * couldn't be started.
+ */
+pid_t spawn_module(const FilePath &module, MemKey key,
+                   const SpawnOptions &options);
+
+/**
+ * @brief Spawn every requested module, using up to `max_threads`
+ * threads to spawn them concurrently.
+ *
+ * @param requests The modules to spawn.
+ * @param max_threads The maximum number of spawning threads, or 0 to
+ * pick one based on the number of CPUs.
+ * @return The result for each module, in the same order as `requests`.
+ */
+std::vector<SpawnResult> spawn_modules(const std::vector<SpawnRequest> &requests,
+                                       unsigned max_threads = 0);
+
+/**
+ * @brief Spawn every requested module with its options, using up to
+ * `max_threads` threads to spawn them concurrently.
+ *
+ * @param requests The modules to spawn.
+ * @param options The options of each module, in the same order as
+ * `requests`, or empty for defaults.
+ * @param max_threads The maximum number of spawning threads, or 0 to
+ * pick one based on the number of CPUs.
+ * @return The result for each module, in the same order as `requests`.
+ */
+std::vector<SpawnResult> spawn_modules(const std::vector<SpawnRequest> &requests,
+                                       const std::vector<SpawnOptions> &options,
+                                       unsigned max_threads = 0);
+
+#endif /* _MODULE_SPAWNER_H_ */
@@ -4,18 +4,20 @@
 #include <string>
 #include <utility>
 #include <ctime>
-#include <map>
 #include <iostream>
 #include <cstdlib>
 #include <cstring> // for memset
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <queue>
 #include <list>
+#include <vector>
 
 #include "json.hpp" // TODO(llazarek): Replace with real lib
 
 #include "Optional.hpp"
+#include "module_registry.hpp"
 #include <OctopOS/publisher.h>
 #include <OctopOS/subscriber.h>
 #include <OctopOS/octopos.h>
@@ -26,61 +28,68 @@ extern const char*  CONFIG_PATH;
 extern const char*  UPGRADE_TOPIC;
 /** The topic name for module downgrades */
 extern const char*  DOWNGRADE_TOPIC;
-/** The minimum number of seconds of runtime before death for modules.
- *  Modules that die in less than this amount of time will be marked
- *  as having died "suspiciously". This is the *only* criteria for
- *  "suspicious" deaths.
+/** The fraction of its running time that a module must have spent on
+ *  the CPU for a non-clean death to count as "suspicious" regardless
+ *  of how long it ran. Catches modules that spin before they crash.
  */
-extern const time_t RUNTIME_CUTOFF_DOWNGRADE_S;
-/** The maximum number of times in a row that a module can die
- *  "suspiciously" before being downgraded.
- *  See `RUNTIME_CUTOFF_DOWNGRADE_S`.
+extern const double CPU_BURN_CUTOFF_DOWNGRADE;
+/** The stack size of each tentacle listener thread. The default 8 MiB
+ *  stack per module adds up when hundreds of modules run.
  */
-extern const int    DEATH_COUNT_CUTOFF_DOWNGRADE;
+extern const size_t LISTENER_STACK_SIZE;
 /** Should OctopOS listen for module upgrade requests? */
 extern const bool   LISTEN_FOR_MODULE_UPGRADES;
 
 
-typedef long MemKey;
-/** The structure containing all significant information about managed
- *  modules.
- */
-struct Module {
-    /** The PID of the module process. */
-    pid_t pid;
-    /** The ID of the tentacle assigned to the module. */
-    int tentacle_id;
-    /** The time that the module was launched. This is used to
-     *  calculate running time when the module dies.
-     */
-    time_t launch_time;
-    /** Whether the module has been intentionally killed */
-    bool killed;
-    /** Whether the module has been requested to be downgraded */
-    bool downgrade_requested;
-    /** The number of early/"suspicious" _sequential_ deaths of the module. */
-    int early_death_count;
-    /**
-     * Module constructor.
-     * @param _pid
-     * @param _tentacle_id
-     * @param _launch_time
-     * @return A new Module
-     */
-    Module(pid_t _pid, int _tentacle_id, time_t _launch_time):
-        pid(_pid), tentacle_id(_tentacle_id), launch_time(_launch_time),
-        killed(false), downgrade_requested(false),
-        early_death_count(0) { }
-    /**
-     * Module default constructor. Just here to be able to put them in std::map.
-     * Use the real constructor in your code instead.
-     * @return A new Module
-     */
-    Module() { }
+class RestartScheduler;
+
+/** What ended a module's run, as derived from its wait status. */
+enum DeathCause {
+    /** Exited with status 0. */
+    DEATH_CLEAN_EXIT,
+    /** Exited with a non-zero status. */
+    DEATH_ERROR_EXIT,
+    /** Killed by a signal indicating a bug: SIGSEGV, SIGBUS, SIGILL,
+     *  SIGFPE, SIGABRT or SIGSYS. */
+    DEATH_CRASH,
+    /** Killed by SIGKILL. Unless the driver sent it, this is usually the
+     *  kernel's OOM killer. */
+    DEATH_KILLED,
+    /** Killed by any other signal, e.g. SIGTERM. */
+    DEATH_TERMINATED
 };
-typedef std::map<std::string, Module> ModuleInfo;
+
+/** The set of managed modules, keyed by executable path. */
+typedef ModuleRegistry ModuleInfo;
 typedef std::pair<ModuleInfo, MemKey> LaunchInfo;
-typedef std::string FilePath;
+
+/** How the enabled modules differ from the managed ones. */
+struct ModuleDiff {
+    /** Modules that are enabled but not managed, or were retired. */
+    std::vector<FilePath> added;
+    /** Managed modules that are no longer enabled. */
+    std::vector<FilePath> removed;
+    /** Managed modules that are still enabled but whose settings in the
+     *  config have changed. */
+    std::vector<FilePath> reconfigured;
+};
+
+/**
+ * @brief Get the tentacle used by the module launched with the given
+ * memory key.
+ *
+ * @param key A memory key from `MSGKEY` upwards.
+ * @return The tentacle index; module tentacles start at 1.
+ */
+int memkey_to_tentacle_index(MemKey key);
+
+/**
+ * @brief The inverse of `memkey_to_tentacle_index`.
+ *
+ * @param index A module's tentacle index.
+ * @return The memory key of the module.
+ */
+int tentacle_index_to_memkey(int index);
 
 /**
  * Is `file` accessible?
@@ -97,15 +106,26 @@ bool accessible(FilePath file);
 CDH::Optional<json> load(FilePath json_file);
 
 /**
- * Launch the given MODULE with memory key KEY.
+ * @brief Block SIGCHLD in the calling thread. Child deaths are
+ * delivered to the babysitting loop through a signalfd, which only
+ * works if *every* thread of the driver blocks SIGCHLD. Call this
+ * before spawning any threads so that they all inherit the mask.
+ *
+ * @return Success status.
+ */
+bool block_child_signals();
+
+/**
+ * Launch the given MODULE with memory key KEY. See `spawn_module`.
  * @param module The path to the module executable.
  * @param key The memory key to provide the module.
- * @return The PID of the launched module.
+ * @return The PID of the launched module, or -1 if it couldn't be started.
  */
 pid_t launch(FilePath module, MemKey key);
 
 /**
- * @brief Relaunch the given module at the given path.
+ * @brief Relaunch the given module at the given path. If the module
+ * can't be started, its `pid` is -1 and `launch_error` records why.
  *
  * @param module Reference to the module to relaunch, *which will be mutated*.
  * @param path The path of the module executable.
@@ -116,14 +136,65 @@ void relaunch(Module *module, FilePath path);
  * @brief Launch all of the modules in the given directory, starting
  * with the given memory key. The memory key will be given to the
  * first module, and every module after will get the previous module's
- * memory key + 1.
+ * memory key + 1. The modules are spawned concurrently.
  *
  * @param dir The absolute path to the directory containing module
  * executables to launch.
  * @param start_key The starting memory key
+ * @param config The octopOS config, from which each module's settings
+ * are taken (see `ModuleConfig`).
  * @return A pair of the `Module`s launched and the next unused memory key.
  */
-LaunchInfo launch_modules_in(FilePath dir, MemKey start_key);
+LaunchInfo launch_modules_in(FilePath dir, MemKey start_key,
+                             const json &config = json());
+
+/**
+ * @brief Launch the given modules concurrently and add them to the set
+ * of active modules. Keys are given out as by `launch_modules_in`.
+ *
+ * @param paths The module executables to launch.
+ * @param start_key The starting memory key
+ * @param config The octopOS config.
+ * @param modules The set of active modules, which *will be mutated.*
+ * @return The next unused memory key.
+ */
+MemKey launch_modules(const std::list<FilePath> &paths, MemKey start_key,
+                      const json &config, ModuleInfo *modules);
+
+/**
+ * @brief Compare the managed modules with the enabled ones.
+ *
+ * @param modules The set of active modules.
+ * @param enabled The module executables that should be running.
+ * @param config The octopOS config, to compare settings against.
+ * @return The modules to launch, retire and reconfigure.
+ */
+ModuleDiff diff_modules(const ModuleInfo &modules,
+                        const std::list<FilePath> &enabled,
+                        const json &config);
+
+/**
+ * @brief Launch, retire and reconfigure modules as given by a diff,
+ * leaving every other module running untouched.
+ *
+ * Removed modules are killed and marked `retired` so that they aren't
+ * relaunched. Re-enabled modules get their old slot and tentacle back;
+ * new ones get fresh memory keys. Reconfigured modules only have their
+ * settings updated, which take effect from their next death.
+ *
+ * @param diff The changes, from `diff_modules`.
+ * @param config The new octopOS config.
+ * @param next_key The next unused memory key.
+ * @param modules The set of active modules, which *will be mutated.*
+ * @param downgrade_pub The publisher for downgrade requests, for new
+ * modules that can't be started.
+ * @param scheduler The scheduler holding delayed restarts, if any.
+ * @return The next unused memory key.
+ */
+MemKey apply_module_diff(const ModuleDiff &diff, const json &config,
+                         MemKey next_key, ModuleInfo *modules,
+                         publisher<OctoString> *downgrade_pub,
+                         RestartScheduler *scheduler = NULL);
 
 /**
  * @brief List the modules in the given directory.
@@ -154,6 +225,10 @@ bool launch_octopOS_listeners();
  * @brief Launch the OctopOS primary listener thread handling all
  * communication via tentacles.
  *
+ * At most one listener runs per tentacle, so this can be called again
+ * for a relaunched module. Listener threads are detached and have a
+ * `LISTENER_STACK_SIZE` stack.
+ *
  * @param tentacle_index The tentacle index on which the listener
  * should operate.
  * @return Success status.
@@ -171,15 +246,55 @@ bool launch_octopOS_listener_for_child(int tentacle_index);
 CDH::Optional<std::string> find_module_with(pid_t pid, const ModuleInfo &modules);
 
 /**
- * @brief Reboot the module with the given executable path.
+ * @brief Relaunch the module in the given slot, requesting a downgrade
+ * if its executable can't be started.
+ *
+ * @param slot The slot of the module to relaunch.
+ * @param modules The set of active modules, which *will be mutated.*
+ * @param downgrade_pub The publisher for downgrade requests.
+ */
+void relaunch_module(ModuleSlot slot, ModuleInfo *modules,
+                     publisher<OctoString> *downgrade_pub);
+
+/**
+ * @brief Reboot the module with the given executable path. Modules
+ * that die suspiciously often, or whose executable can no longer be
+ * started, are downgraded instead.
  *
  * @param path The path of the module to reboot.
  * @param modules The set of active modules, which *will be mutated to
  * update with the rebooted module information.*
  * @param downgrade_pub The publisher for downgrade requests.
+ * @param scheduler If given, modules that keep dying suspiciously are
+ * restarted after a backoff delay from this scheduler rather than
+ * immediately (see `RestartPolicy`).
  */
 void reboot_module(std::string path, ModuleInfo *modules,
-                   publisher<OctoString> *downgrade_pub);
+                   publisher<OctoString> *downgrade_pub,
+                   RestartScheduler *scheduler = NULL);
+
+/**
+ * @brief Mark the given module as waiting for a downgrade and publish
+ * a downgrade request for it.
+ *
+ * @param path The path of the module to downgrade.
+ * @param module The module, *which will be mutated.*
+ * @param downgrade_pub The publisher for downgrade requests.
+ */
+void request_downgrade(FilePath path, Module *module,
+                       publisher<OctoString> *downgrade_pub);
+
+/**
+ * @brief Request a downgrade for every module whose executable
+ * couldn't be started (see `Module::launch_error`) and that isn't
+ * already waiting for one. Such modules have no process that could
+ * die, so the usual death-counting never catches them.
+ *
+ * @param modules The set of active modules, which *will be mutated.*
+ * @param downgrade_pub The publisher for downgrade requests.
+ */
+void downgrade_unstartable_modules(ModuleInfo *modules,
+                                   publisher<OctoString> *downgrade_pub);
 
 /**
  * @brief Kill the module with the given executable path.
@@ -187,30 +302,116 @@ void reboot_module(std::string path, ModuleInfo *modules,
  * @param path The path of the module to kill.
  * @param modules The set of active modules, which *will be mutated to
  * update the killed `Module`.
- * @return The return of the `kill` system command.
+ * @return The return of the `kill` system command, or -1 with errno
+ * ESRCH if the module isn't running.
  */
 int kill_module(std::string path, ModuleInfo *modules);
 
+/**
+ * @brief Classify a wait status.
+ *
+ * @param status A wait status as returned by `wait4`.
+ * @return What ended the process.
+ */
+DeathCause death_cause(int status);
+
+/**
+ * @brief Record a death of the given module: its wait status, and the
+ * resources it used while it ran.
+ *
+ * @param module The module that died, *which will be mutated.*
+ * @param status The wait status of the death.
+ * @param usage The resource usage of the dead process, from `wait4`.
+ */
+void record_death(Module *module, int status, const struct rusage &usage);
+
 /**
  * @brief Does the given module need a downgrade? Note that *the given
  * module may be mutated to record early deaths.*
  *
+ * A death is "suspicious" if the module ran for less than
+ * its `RestartPolicy::runtime_cutoff_s`, crashed or was SIGKILLed (see
+ * `DeathCause`), or didn't exit cleanly after spending more than
+ * `CPU_BURN_CUTOFF_DOWNGRADE` of its life on the CPU. Call
+ * `record_death` first so that the cause of the death is known.
+ *
  * @param module
  * @return Does the given module need a downgrade?
  */
 bool module_needs_downgrade(Module *module);
 
+/**
+ * @brief Handle a request to upgrade the module at the given path. A
+ * module that is waiting for a downgrade or isn't running (e.g. it
+ * never started) is relaunched; otherwise the
+ * module is killed so that it gets relaunched from its (upgraded)
+ * executable when its death is noticed.
+ *
+ * A module waiting for a delayed restart is relaunched right away.
+ *
+ * @param module_path The path of the module to upgrade.
+ * @param modules The set of active modules, which *will be mutated.*
+ * @param scheduler The scheduler holding delayed restarts, if any.
+ */
+void handle_upgrade_request(std::string module_path, ModuleInfo *modules,
+                            RestartScheduler *scheduler = NULL);
+
+/**
+ * @brief Handle a batch of upgrade requests in one pass. Duplicate
+ * requests for a module are handled once, and a request for a module
+ * that is already being replaced is ignored. Running modules are all
+ * killed before any death is handled; modules with nothing running
+ * are relaunched together (see `relaunch_modules`).
+ *
+ * @param module_paths The paths of the modules to upgrade, in the
+ * order requested.
+ * @param modules The set of active modules, which *will be mutated.*
+ * @param downgrade_pub The publisher for downgrade requests, for
+ * relaunched modules that can't be started. May be NULL.
+ * @param scheduler The scheduler holding delayed restarts, if any.
+ */
+void handle_upgrade_requests(const std::vector<std::string> &module_paths,
+                             ModuleInfo *modules,
+                             publisher<OctoString> *downgrade_pub,
+                             RestartScheduler *scheduler = NULL);
+
+/**
+ * @brief Relaunch the modules in the given slots concurrently. See
+ * `spawn_modules`.
+ *
+ * @param slots The slots of the modules to relaunch.
+ * @param modules The set of active modules, which *will be mutated.*
+ * @param downgrade_pub The publisher for downgrade requests, for
+ * modules that can't be started. May be NULL.
+ */
+void relaunch_modules(const std::vector<ModuleSlot> &slots,
+                      ModuleInfo *modules,
+                      publisher<OctoString> *downgrade_pub);
+
 /**
  * @brief Babysit the given active modules, rebooting and/or
  * downgrading them if they die and handling upgrade requests.
  *
+ * Sleeps until a child dies or an upgrade request arrives, so no CPU
+ * is used while all modules are healthy. Never returns.
+ *
+ * If a config is given, `CONFIG_PATH` and its `modules_enabled`
+ * directory are watched and changes to either are applied as they
+ * happen (see `ConfigReloader`). Modules whose config asks for it are
+ * killed if they stop beating (see `Watchdog`). Metrics are served on
+ * the config's `metrics_socket`, or `METRICS_SOCKET_PATH` (see
+ * `MetricsServer`).
+ *
  * @param modules The active set of modules.
  * @param downgrade_pub The publisher for downgrade requests.
  * @param upgrade_sub The subsriber for upgrade requests.
+ * @param config The octopOS config the modules were launched with.
+ * @param next_key The next unused memory key, for modules added later.
  */
 void babysit_forever(ModuleInfo *modules,
                      publisher<OctoString> *downgrade_pub,
-                     subscriber<OctoString> *upgrade_sub);
+                     subscriber<OctoString> *upgrade_sub,
+                     const json &config = json(), MemKey next_key = 0);
 
 /**
  * @brief Launch OctopOS.
@@ -225,8 +426,11 @@ octopOS& launch_octopOS();
  *
  * @param modules The active set of modules.
  * @param downgrade_pub The publisher for downgrade requests.
+ * @param scheduler The scheduler for delayed restarts, if any. See
+ * `reboot_module`.
  */
 void reboot_dead_modules(ModuleInfo *modules,
-                         publisher<OctoString> *downgrade_pub);
+                         publisher<OctoString> *downgrade_pub,
+                         RestartScheduler *scheduler = NULL);
 
 #endif /* _OCTOPOS_DRIVER_H_ */
@@ -0,0 +1,66 @@
+#ifndef _RESTART_SCHEDULER_H_
+#define _RESTART_SCHEDULER_H_
+
+#include <random>
+#include <unordered_map>
+
+#include "event_loop.hpp"
+#include "module_registry.hpp"
+
+/**
+ * @brief Schedules delayed module restarts on an `EventLoop`, so that a
+ * module stuck in a crash loop is restarted with exponential backoff
+ * (see `RestartPolicy`) instead of as fast as it can die.
+ *
+ * At most one restart is pending per module. Pending restarts live in
+ * the loop's timer wheel, so thousands of them cost O(1) each.
+ */
+class RestartScheduler {
+public:
+    /**
+     * @brief Create a scheduler.
+     *
+     * @param loop The loop to run restarts on.
+     */
+    explicit RestartScheduler(EventLoop *loop);
+
+    /**
+     * @brief How long to wait before restarting the given module after
+     * its latest death.
+     *
+     * @param module A module that has just died.
+     * @return The delay in milliseconds; 0 to restart immediately.
+     */
+    int64_t delay_for(const Module &module);
+
+    /**
+     * @brief Run `restart` after `delay_ms`, replacing any restart
+     * already pending for the module in `slot`.
+     *
+     * @param slot The module's slot.
+     * @param delay_ms The delay in milliseconds.
+     * @param restart The callback that restarts the module.
+     */
+    void schedule(ModuleSlot slot, int64_t delay_ms,
+                  EventLoop::Callback restart);
+
+    /** @return Whether a restart is pending for the module in `slot`. */
+    bool pending(ModuleSlot slot) const { return timers.count(slot) > 0; }
+
+    /** @return The number of pending restarts. */
+    size_t pending_count() const { return timers.size(); }
+
+    /**
+     * @brief Cancel the pending restart of the module in `slot`, if any.
+     *
+     * @param slot The module's slot.
+     */
+    void cancel(ModuleSlot slot);
+
+private:
+    EventLoop *loop;
+    std::unordered_map<ModuleSlot, TimerId> timers;
+    std::minstd_rand random;
+};
+
+#endif /* _RESTART_SCHEDULER_H_ */
@@ -0,0 +1,166 @@
+#ifndef _SHM_DOORBELL_H_
+#define _SHM_DOORBELL_H_
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <string>
+
+#include "module_registry.hpp"
+
+/**
+ * @brief The layout of a doorbell in shared memory.
+ */
+struct ShmDoorbellState {
+    /** Counts rings; the futex word sleepers wait on. */
+    std::atomic<uint32_t> rings;
+    /** Nonzero while the owner is, or is about to be, asleep. */
+    std::atomic<uint32_t> sleeping;
+};
+
+/**
+ * @brief Get the name of the shared memory object of a module's
+ * doorbell.
+ *
+ * @param key The module's memory key.
+ * @return A name for `shm_open`.
+ */
+inline std::string shm_doorbell_name(MemKey key) {
+    return "/octopOS.doorbell." + std::to_string(key);
+}
+
+/**
+ * @brief Wakes a module sleeping until any of its topics has data.
+ *
+ * Each module that waits for data owns one doorbell, a futex word in
+ * shared memory, and any publisher can ring it. Ringing is a single
+ * load unless the owner is asleep, so publishers only pay for a
+ * syscall when it wakes somebody up. A futex is used rather than an
+ * eventfd because publishers are unrelated processes that can't share
+ * file descriptors.
+ */
+class ShmDoorbell {
+public:
+    ShmDoorbell(): state(NULL) { }
+    ShmDoorbell(ShmDoorbell &&other): state(other.state) {
+        other.state = NULL;
+    }
+    ~ShmDoorbell() { close(); }
+
+    /**
+     * @brief Map a module's doorbell, creating it if needed. Used by the
+     * module that sleeps on it.
+     *
+     * @param key The module's memory key.
+     * @return Success status.
+     */
+    bool create(MemKey key) { return map(key, true); }
+
+    /**
+     * @brief Map a module's existing doorbell. Used by publishers.
+     *
+     * @param key The module's memory key.
+     * @return Success status.
+     */
+    bool open(MemKey key) { return map(key, false); }
+
+    /** Unmap the doorbell. */
+    void close() {
+        if (state) {
+            munmap(state, sizeof(ShmDoorbellState));
+        }
+        state = NULL;
+    }
+
+    /** @return Whether a doorbell is mapped. */
+    bool is_open() const { return state != NULL; }
+
+    /** Wake the owner if it is asleep. Call after publishing. */
+    void ring() {
+        if (state->sleeping.load()) {
+            state->rings.fetch_add(1);
+            futex(FUTEX_WAKE, INT_MAX, NULL);
+        }
+    }
+
+    /**
+     * @brief Announce that the owner is about to sleep. It must then
+     * check for data, and either `sleep` or `cancel`; a publisher that
+     * publishes after this rings the doorbell.
+     *
+     * @return The ring count to pass to `sleep`.
+     */
+    uint32_t prepare() {
+        state->sleeping.store(1);
+        return state->rings.load();
+    }
+
+    /**
+     * @brief Sleep until the doorbell rings.
+     *
+     * @param seen The ring count returned by `prepare`.
+     * @param timeout_ms The most milliseconds to sleep; -1 for no limit.
+     * @return false if the sleep timed out.
+     */
+    bool sleep(uint32_t seen, int timeout_ms) {
+        struct timespec timeout = {timeout_ms / 1000,
+                                   (timeout_ms % 1000) * 1000000L};
+        bool rung = true;
+        if (state->rings.load() == seen &&
+            futex(FUTEX_WAIT, seen, timeout_ms < 0 ? NULL : &timeout) &&
+            errno == ETIMEDOUT) {
+            rung = false;
+        }
+        state->sleeping.store(0);
+        return rung;
+    }
+
+    /** Don't sleep after all. */
+    void cancel() { state->sleeping.store(0); }
+
+private:
+    ShmDoorbellState *state;
+
+    bool map(MemKey key, bool create) {
+        close();
+        int fd = shm_open(shm_doorbell_name(key).c_str(),
+                          create ? O_RDWR | O_CREAT : O_RDWR, 0660);
+        if (fd == -1) {
+            return false;
+        }
+        // Zero filled, so a new doorbell starts awake with no rings
+        struct stat st;
+        if (create ? ftruncate(fd, sizeof(ShmDoorbellState)) == -1 :
+            fstat(fd, &st) == -1 ||
+            (size_t)st.st_size < sizeof(ShmDoorbellState)) {
+            ::close(fd);
+            return false;
+        }
+        void *addr = mmap(NULL, sizeof(ShmDoorbellState),
+                          PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        state = static_cast<ShmDoorbellState*>(addr);
+        return true;
+    }
+
+    int futex(int op, uint32_t value, const struct timespec *timeout) {
+        // Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+        return syscall(SYS_futex, &state->rings, op, value, timeout, NULL, 0);
+    }
+
+    ShmDoorbell(const ShmDoorbell&);
+    ShmDoorbell& operator=(const ShmDoorbell&);
+};
+
+#endif /* _SHM_DOORBELL_H_ */
@@ -0,0 +1,554 @@
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "module_registry.hpp"
+#include "shm_doorbell.hpp"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory rings need lock-free 64 bit atomics");
+
+/** Identifies a mapped shared memory ring ("OCTR"). */
+const uint32_t SHM_RING_MAGIC = 0x4f435452;
+/** The most readers of a ring that can have their doorbell rung. */
+const uint32_t SHM_RING_MAX_SUBSCRIBERS = 16;
+
+/**
+ * @brief The layout of the start of a shared memory ring. Slots follow
+ * it, each `slot_size` bytes: a sequence number, then the payload.
+ */
+struct ShmRingHeader {
+    /** `SHM_RING_MAGIC` once the ring is initialized. */
+    std::atomic<uint32_t> magic;
+    /** The number of slots; a power of 2. */
+    uint32_t capacity;
+    /** The size of each slot in bytes. */
+    uint32_t slot_size;
+    /** The size of the payload type in bytes. */
+    uint32_t payload_size;
+    /** The memory key of the module that publishes to the ring. */
+    std::atomic<int64_t> owner_key;
+    /** Set when the publisher replaced the ring with a new layout;
+     *  readers should reopen it. */
+    std::atomic<uint32_t> retired;
+    /** The memory keys, plus one, of the modules whose doorbells are
+     *  rung when messages are published; 0 for a free entry. */
+    alignas(64) std::atomic<int64_t> subscribers[SHM_RING_MAX_SUBSCRIBERS];
+    /** The number of messages ever published; the next message's
+     *  sequence number. On its own cache line, since it is the only
+     *  field that changes. */
+    alignas(64) std::atomic<uint64_t> head;
+};
+
+/**
+ * @brief Get the name of the shared memory object of a topic's ring.
+ *
+ * @param topic The topic.
+ * @return A name for `shm_open`.
+ */
+inline std::string shm_ring_name(const std::string &topic) {
+    return "/octopOS." + topic;
+}
+
+template <typename T> class ShmRingWriter;
+template <typename T> class ShmRingReader;
+
+/**
+ * @brief A mapping of a topic's shared memory ring. See
+ * `ShmRingWriter` and `ShmRingReader`.
+ */
+template <typename T>
+class ShmRing {
+public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Ring payloads are copied as raw bytes, so they must be "
+                  "trivially copyable (no std::string, pointers, etc.)");
+
+    /** The size of each slot: a sequence number and a payload, rounded
+     *  up to whole cache lines so that slots don't share them. */
+    static const size_t SLOT_SIZE =
+        (sizeof(std::atomic<uint64_t>) + sizeof(T) + 63) / 64 * 64;
+
+    ShmRing(): header(NULL), slots(NULL), mapped_size(0) { }
+    ShmRing(ShmRing &&other): header(other.header), slots(other.slots),
+        mapped_size(other.mapped_size) {
+        other.header = NULL;
+        other.slots = NULL;
+        other.mapped_size = 0;
+    }
+    ~ShmRing() { unmap(); }
+
+    /** @return Whether a ring is mapped. */
+    bool is_open() const { return header != NULL; }
+
+    /**
+     * @brief Map the topic's ring, creating or replacing it as needed.
+     *
+     * @param topic The topic.
+     * @param capacity The minimum number of slots.
+     * @param owner_key The memory key of the publishing module.
+     * @return Success status; errno is EBUSY if another module
+     * publishes to the topic.
+     */
+    bool create(const std::string &topic, uint32_t capacity,
+                MemKey owner_key) {
+        unmap();
+        uint32_t slots_wanted = 1;
+        while (slots_wanted < capacity) {
+            slots_wanted <<= 1;
+        }
+        std::string name = shm_ring_name(topic);
+        if (attach(name, true)) {
+            if (header->capacity == slots_wanted &&
+                header->payload_size == sizeof(T) &&
+                header->slot_size == SLOT_SIZE) {
+                int64_t owner = header->owner_key.load();
+                if (owner != owner_key) {
+                    unmap();
+                    errno = EBUSY;
+                    return false;
+                }
+                // A restarted publisher carries on where it left off,
+                // and its readers never notice
+                return true;
+            }
+            // The layout changed, e.g. with an upgraded module; tell
+            // readers to move to the new ring
+            header->retired.store(1);
+            for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+                ShmDoorbell doorbell;
+                int64_t subscriber = header->subscribers[i].load();
+                if (subscriber && doorbell.open(subscriber - 1)) {
+                    doorbell.ring();
+                }
+            }
+            unmap();
+            shm_unlink(name.c_str());
+        } else if (errno == EAGAIN) {
+            // Left half-initialized by a publisher that died creating it
+            shm_unlink(name.c_str());
+        }
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+        if (fd == -1) {
+            return false;
+        }
+        size_t size = sizeof(ShmRingHeader) + (size_t)slots_wanted * SLOT_SIZE;
+        if (ftruncate(fd, size) == -1 || !map(fd, size, true)) {
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        close(fd);
+        // The object starts zeroed, so every sequence number is 0
+        header->capacity = slots_wanted;
+        header->slot_size = SLOT_SIZE;
+        header->payload_size = sizeof(T);
+        header->owner_key.store(owner_key);
+        header->retired.store(0);
+        header->head.store(0);
+        header->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Map the topic's existing ring.
+     *
+     * @param topic The topic.
+     * @return false if the topic has no initialized ring with this
+     * payload type.
+     */
+    bool open(const std::string &topic) {
+        unmap();
+        // Writable, so that readers can subscribe
+        if (!attach(shm_ring_name(topic), true)) {
+            return false;
+        }
+        if (header->payload_size != sizeof(T) ||
+            header->slot_size != SLOT_SIZE) {
+            unmap();
+            errno = EPROTO;
+            return false;
+        }
+        return true;
+    }
+
+    /** Unmap the ring. */
+    void unmap() {
+        if (header) {
+            munmap(header, mapped_size);
+        }
+        header = NULL;
+        slots = NULL;
+        mapped_size = 0;
+    }
+
+private:
+    friend class ShmRingWriter<T>;
+    friend class ShmRingReader<T>;
+
+    ShmRingHeader *header;
+    char *slots;
+    size_t mapped_size;
+
+    /** @return The sequence number of the given message's slot. */
+    std::atomic<uint64_t>& sequence_of(uint64_t message) const {
+        return *reinterpret_cast<std::atomic<uint64_t>*>(
+            slots + (message & (header->capacity - 1)) * SLOT_SIZE);
+    }
+
+    /** @return The payload of the given message's slot. */
+    T* payload_of(uint64_t message) const {
+        return reinterpret_cast<T*>(
+            slots + (message & (header->capacity - 1)) * SLOT_SIZE +
+            sizeof(std::atomic<uint64_t>));
+    }
+
+    bool attach(const std::string &name, bool writable) {
+        int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 &&
+            (size_t)st.st_size >= sizeof(ShmRingHeader) &&
+            map(fd, st.st_size, writable);
+        close(fd);
+        if (!ok) {
+            return false;
+        }
+        if (header->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC ||
+            mapped_size < sizeof(ShmRingHeader) +
+                (size_t)header->capacity * header->slot_size) {
+            // Not initialized yet, or not a ring at all
+            unmap();
+            errno = EAGAIN;
+            return false;
+        }
+        return true;
+    }
+
+    bool map(int fd, size_t size, bool writable) {
+        void *addr = mmap(NULL, size,
+                          writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                          MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        header = static_cast<ShmRingHeader*>(addr);
+        slots = static_cast<char*>(addr) + sizeof(ShmRingHeader);
+        mapped_size = size;
+        return true;
+    }
+
+    ShmRing(const ShmRing&);
+    ShmRing& operator=(const ShmRing&);
+};
+
+template <typename T>
+const size_t ShmRing<T>::SLOT_SIZE;
+
+/**
+ * @brief Publishes fixed-layout messages to a topic through a ring in
+ * shared memory, without serializing them.
+ *
+ * The ring has one publisher and any number of readers. Publishing
+ * never blocks and never waits for readers: once the ring is full, the
+ * oldest message is overwritten and readers that hadn't read it yet
+ * count it as dropped. Each slot is guarded by its own sequence
+ * number (a seqlock), so readers never see a half-written message.
+ *
+ * A message is written once, straight into shared memory: either with
+ * `publish`, or in place with `claim` and `commit`. Several messages
+ * may be claimed before a `commit`, which publishes them all at once.
+ */
+template <typename T>
+class ShmRingWriter {
+public:
+    ShmRingWriter(): pending_messages(0) {
+        for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+            doorbell_keys[i] = 0;
+        }
+    }
+
+    /**
+     * @brief Create or reattach to the topic's ring.
+     *
+     * @param topic The topic.
+     * @param capacity The minimum number of messages kept.
+     * @param owner_key The publishing module's memory key. A module
+     * relaunched with the same key reattaches to its ring.
+     * @return Success status.
+     */
+    bool open(const std::string &topic, uint32_t capacity,
+              MemKey owner_key) {
+        pending_messages = 0;
+        return ring.create(topic, capacity, owner_key);
+    }
+
+    /** @return Whether the ring is open. */
+    bool is_open() const { return ring.is_open(); }
+
+    /** @return The number of messages the ring keeps. */
+    uint32_t capacity() const { return ring.header->capacity; }
+
+    /** @return The number of messages claimed but not yet committed. */
+    uint32_t pending() const { return pending_messages; }
+
+    /**
+     * @brief Start writing the next message in place. Call `commit`
+     * once it is written. At most `capacity` messages may be pending.
+     *
+     * @return The message's payload in shared memory.
+     */
+    T* claim() {
+        uint64_t message = ring.header->head.load(std::memory_order_relaxed) +
+            pending_messages++;
+        // Odd: being written
+        ring.sequence_of(message).store(2 * message + 1,
+                                        std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return ring.payload_of(message);
+    }
+
+    /** Publish the messages started with `claim`, and wake subscribers.
+     *  Readers see the whole batch at once. */
+    void commit() {
+        if (!pending_messages) {
+            return;
+        }
+        uint64_t head = ring.header->head.load(std::memory_order_relaxed);
+        for (uint64_t message = head; message < head + pending_messages;
+             message++) {
+            ring.sequence_of(message).store(2 * message + 2,
+                                            std::memory_order_release);
+        }
+        ring.header->head.store(head + pending_messages,
+                                std::memory_order_release);
+        pending_messages = 0;
+        ring_subscribers();
+    }
+
+    /**
+     * @brief Publish a message.
+     *
+     * @param value The message.
+     */
+    void publish(const T &value) {
+        memcpy(claim(), &value, sizeof(T));
+        commit();
+    }
+
+    /** @return The number of messages ever published to the ring. */
+    uint64_t published() const {
+        return ring.header->head.load(std::memory_order_relaxed);
+    }
+
+private:
+    ShmRing<T> ring;
+    uint32_t pending_messages;
+    /** The subscribers' doorbells, mapped on first use. */
+    ShmDoorbell doorbells[SHM_RING_MAX_SUBSCRIBERS];
+    int64_t doorbell_keys[SHM_RING_MAX_SUBSCRIBERS];
+
+    void ring_subscribers() {
+        // Pairs with the fence in `ShmRingReader::available` after a
+        // sleeper announces itself: either it sees the new head, or we
+        // see that it is asleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+            int64_t subscriber =
+                ring.header->subscribers[i].load(std::memory_order_relaxed);
+            if (!subscriber) {
+                continue;
+            }
+            if (subscriber != doorbell_keys[i]) {
+                doorbell_keys[i] = doorbells[i].open(subscriber - 1) ?
+                    subscriber : 0;
+                if (!doorbell_keys[i]) {
+                    continue;
+                }
+            }
+            doorbells[i].ring();
+        }
+    }
+};
+
+/**
+ * @brief Reads messages published to a topic by a `ShmRingWriter`.
+ * Each reader has its own position, so every reader sees every message
+ * published after it opened the ring, unless it falls more than the
+ * ring's capacity behind.
+ */
+template <typename T>
+class ShmRingReader {
+public:
+    ShmRingReader(): next(0), dropped_messages(0), subscriber(0) { }
+    ShmRingReader(ShmRingReader &&other): ring(std::move(other.ring)),
+        name(std::move(other.name)), next(other.next),
+        dropped_messages(other.dropped_messages),
+        subscriber(other.subscriber) {
+        other.subscriber = 0;
+    }
+    ~ShmRingReader() { unsubscribe(); }
+
+    /**
+     * @brief Open the topic's ring, starting after the newest message.
+     *
+     * @param topic The topic.
+     * @param from_oldest Start at the oldest message kept instead.
+     * @return false if nothing has published to the topic yet.
+     */
+    bool open(const std::string &topic, bool from_oldest = false) {
+        unsubscribe();
+        if (!ring.open(topic)) {
+            return false;
+        }
+        name = topic;
+        next = ring.header->head.load(std::memory_order_acquire);
+        if (from_oldest) {
+            next = next > ring.header->capacity ?
+                next - ring.header->capacity : 0;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Have the publisher ring a module's doorbell (see
+     * `ShmDoorbell`) whenever it publishes. Kept across the ring being
+     * replaced.
+     *
+     * @param key The memory key of the module owning the doorbell.
+     * @return false if the ring isn't open or has too many subscribers.
+     */
+    bool subscribe(MemKey key) {
+        unsubscribe();
+        if (!ring.is_open()) {
+            return false;
+        }
+        int64_t entry = (int64_t)key + 1;
+        std::atomic<int64_t> *subscribers = ring.header->subscribers;
+        // A relaunched module finds its old entry
+        for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+            if (subscribers[i].load() == entry) {
+                subscriber = entry;
+                return true;
+            }
+        }
+        for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+            int64_t free_entry = 0;
+            if (subscribers[i].compare_exchange_strong(free_entry, entry)) {
+                subscriber = entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** @return Whether the ring is open. */
+    bool is_open() const { return ring.is_open(); }
+
+    /**
+     * @brief Copy out the next message, if any.
+     *
+     * @param out Where to copy the message.
+     * @return 1 if a message was read, 0 if none is available.
+     */
+    int read(T *out) {
+        if (!ring.is_open()) {
+            return 0;
+        }
+        while (1) {
+            uint64_t head = ring.header->head.load(std::memory_order_acquire);
+            if (next >= head) {
+                if (ring.header->retired.load(std::memory_order_relaxed)) {
+                    // The publisher moved to a new ring
+                    int64_t resubscribe = subscriber;
+                    if (open(name, true)) {
+                        if (resubscribe) {
+                            subscribe(resubscribe - 1);
+                        }
+                        continue;
+                    }
+                }
+                return 0;
+            }
+            uint64_t capacity = ring.header->capacity;
+            if (head - next > capacity) {
+                // Lapped by the publisher
+                dropped_messages += head - capacity - next;
+                next = head - capacity;
+            }
+            std::atomic<uint64_t> &sequence = ring.sequence_of(next);
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before == 2 * next + 2) {
+                memcpy(out, ring.payload_of(next), sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before) {
+                    next++;
+                    return 1;
+                }
+            }
+            // Overwritten before or while we copied it. Don't wait for
+            // the publisher, which may have died mid-write.
+            dropped_messages++;
+            next++;
+        }
+    }
+
+    /** @return Whether the publisher rings a doorbell for this reader. */
+    bool subscribed() const { return subscriber != 0; }
+
+    /** @return The number of messages that were overwritten before
+     *  this reader got to them. */
+    uint64_t dropped() const { return dropped_messages; }
+
+    /** @return The number of messages waiting to be read; nonzero if
+     *  the ring was replaced, so that `read` moves to the new one. */
+    uint64_t available() const {
+        if (!ring.is_open()) {
+            return 0;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t head = ring.header->head.load(std::memory_order_acquire);
+        if (head <= next) {
+            return ring.header->retired.load(std::memory_order_relaxed);
+        }
+        return head - next;
+    }
+
+private:
+    ShmRing<T> ring;
+    std::string name;
+    uint64_t next;
+    uint64_t dropped_messages;
+    /** The subscribed memory key plus one, or 0. */
+    int64_t subscriber;
+
+    void unsubscribe() {
+        if (subscriber && ring.is_open()) {
+            for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+                int64_t entry = subscriber;
+                if (ring.header->subscribers[i].compare_exchange_strong(
+                        entry, 0)) {
+                    break;
+                }
+            }
+        }
+        subscriber = 0;
+    }
+};
+
+#endif /* _SHM_RING_H_ */
@@ -0,0 +1,109 @@
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Optional.hpp"
+
+/** Identifies a timer scheduled on a `TimerWheel`. */
+typedef uint64_t TimerId;
+
+/**
+ * @brief A hierarchical timer wheel with millisecond ticks.
+ *
+ * Four levels of 256 slots cover deadlines up to 2^32 ms (~49 days)
+ * away; later deadlines are parked in the last level and re-filed as
+ * time passes. Scheduling and cancelling are O(1) no matter how many
+ * timers are pending, and each timer is moved between levels at most
+ * three times before it fires, so thousands of pending restarts,
+ * watchdog deadlines and stop timeouts stay cheap.
+ *
+ * The wheel doesn't read any clock itself: time only moves when
+ * `advance` is called.
+ */
+class TimerWheel {
+public:
+    typedef std::function<void()> Callback;
+
+    /**
+     * @brief Create an empty wheel.
+     *
+     * @param now_ms The current time in milliseconds.
+     */
+    explicit TimerWheel(int64_t now_ms);
+
+    /**
+     * @brief Run `callback` once `advance` reaches `deadline_ms`.
+     * Deadlines that have already passed fire on the next tick.
+     *
+     * @param deadline_ms The absolute deadline in milliseconds.
+     * @param callback The callback to run.
+     * @return The ID of the new timer.
+     */
+    TimerId schedule(int64_t deadline_ms, Callback callback);
+
+    /**
+     * @brief Cancel a pending timer.
+     *
+     * @param id The timer to cancel.
+     * @return Whether the timer was pending.
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief Move time forward, running every timer whose deadline is
+     * at or before `now_ms`. Callbacks may schedule and cancel timers.
+     *
+     * @param now_ms The current time in milliseconds.
+     * @return The number of timers that fired.
+     */
+    size_t advance(int64_t now_ms);
+
+    /**
+     * @brief A lower bound on the earliest pending deadline. Waking up
+     * at this time and calling `advance` either fires a timer or moves
+     * timers closer to firing, so it is suitable for arming a timerfd.
+     *
+     * @return The time, if any timers are pending.
+     */
+    CDH::Optional<int64_t> next_deadline() const;
+
+    /** @return The number of pending timers. */
+    size_t size() const { return pending; }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 8;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const uint32_t NIL = 0xFFFFFFFF;
+
+    /** A timer, linked into a slot's doubly linked list by index. */
+    struct Entry {
+        int64_t deadline;
+        Callback callback;
+        uint32_t prev;
+        uint32_t next;
+        /** Bumped every time the entry is freed, to spot stale IDs. */
+        uint32_t generation;
+        /** The level * SLOTS + slot the entry is linked into, or NIL. */
+        uint32_t bucket;
+    };
+
+    int64_t now_tick;
+    size_t pending;
+    size_t level_counts[LEVELS];
+    uint32_t heads[LEVELS * SLOTS];
+    std::vector<Entry> entries;
+    std::vector<uint32_t> free_entries;
+
+    void place(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void cascade(int level);
+    size_t expire_current_slot();
+};
+
+#endif /* _TIMER_WHEEL_H_ */
@@ -0,0 +1,96 @@
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+#include <sys/types.h>
+#include <cstdint>
+#include <vector>
+
+#include "event_loop.hpp"
+#include "heartbeat.hpp"
+#include "octopOS_driver.hpp"
+
+/** The number of entries in the heartbeat table; modules in later
+ *  slots can't be watched. */
+extern const uint32_t HEARTBEAT_TABLE_SIZE;
+/** Heartbeat checks are rounded up to a multiple of this, so that the
+ *  checks of many modules are made in one wakeup of the loop. */
+extern const int64_t WATCHDOG_SLACK_MS;
+
+/**
+ * @brief Kills modules that stop making progress, e.g. because they
+ * deadlocked or are stuck in a loop, which waiting for deaths alone
+ * would never notice.
+ *
+ * Modules beat through the shared memory heartbeat table (see
+ * `Heartbeat`; the Mediator beats on every `yield` and `wait`). Each
+ * watched module has one timer in the loop's timer wheel, which fires
+ * every `WatchdogPolicy::timeout_ms` and checks whether the module's
+ * beat count moved. A module that didn't beat since the last check is
+ * sent SIGKILL, so it is detected within twice its timeout. Its death
+ * is then handled like any other: it counts as suspicious, so it is
+ * restarted with backoff and downgraded if it keeps hanging.
+ *
+ * A check is a few loads, and checks are batched by
+ * `WATCHDOG_SLACK_MS`, so watching many modules costs almost nothing.
+ */
+class Watchdog {
+public:
+    /**
+     * @brief Create a watchdog. Nothing is watched until `start`.
+     *
+     * @param loop The babysitting loop.
+     * @param modules The set of active modules. Hung modules are killed,
+     * and their `hang_count` is incremented.
+     */
+    Watchdog(EventLoop *loop, ModuleInfo *modules);
+
+    /** Stops watching and removes the heartbeat table. */
+    ~Watchdog();
+
+    /**
+     * @brief Create the heartbeat table and watch the modules whose
+     * config asks for it.
+     *
+     * @return Success status.
+     */
+    bool start();
+
+    /**
+     * @brief Apply each module's `WatchdogPolicy` again. Call after
+     * modules are added or reconfigured.
+     */
+    void sync();
+
+    /** @return The number of modules being watched. */
+    size_t watched_count() const { return watched; }
+
+    /** @return The number of hung modules killed so far. */
+    uint64_t hangs_detected() const { return hangs; }
+
+private:
+    struct Watch {
+        bool armed;
+        TimerId timer;
+        /** The process whose beats are being counted. */
+        pid_t pid;
+        /** The beat count at the last check. */
+        uint64_t beats;
+    };
+
+    EventLoop *loop;
+    ModuleInfo *modules;
+    HeartbeatTable table;
+    std::vector<Watch> watches;
+    size_t watched;
+    uint64_t hangs;
+
+    int64_t timeout_of(ModuleSlot slot) const;
+    void arm(ModuleSlot slot, int64_t delay_ms);
+    void disarm(ModuleSlot slot);
+    void check(ModuleSlot slot);
+
+    Watchdog(const Watchdog&);
+    Watchdog& operator=(const Watchdog&);
+};
+
+#endif /* _WATCHDOG_H_ */
@@ -16,9 +16,12 @@
 #include <OctopOS/publisher.h>
 
 #include "Optional.hpp"
+#include "journal.hpp"
 #include "octopOS_driver.hpp"
 
 int main(int argc, char const *argv[]) {
+    // Must happen before any threads are spawned
+    block_child_signals();
     octopOS &octopos = launch_octopOS();
     MemKey current_key = MSGKEY;
 
@@ -30,10 +33,27 @@ int main(int argc, char const *argv[]) {
         return 1;
     }
     json config = maybe_config.get();
+    if (!config["modules_enabled"].is_string()) {
+        std::cerr << "Critical Error: No modules_enabled directory in config "
+                  << "at " << CONFIG_PATH << ". Exiting..." << std::endl;
+        return 1;
+    }
 
+    // Record supervisor events from the first launch on
+    const json &settings = config;
+    Journal journal;
+    FilePath journal_path = settings.value("journal_path", JOURNAL_PATH);
+    int64_t journal_max_kb = settings.value("journal_max_kb",
+                                            (int64_t)JOURNAL_MAX_BYTES / 1024);
+    if (journal.open(journal_path, journal_max_kb * 1024)) {
+        set_journal(&journal);
+    } else {
+        std::cerr << "Error: Unable to open the journal at " << journal_path
+                  << ". Supervisor events won't be recorded." << std::endl;
+    }
 
     LaunchInfo launched = launch_modules_in(config["modules_enabled"],
-                                            current_key);
+                                            current_key, config);
     ModuleInfo modules = launched.first;
     // Keep track of the memkeys we've given out so that we can give valid ones
     // when creating our own pub/subs
@@ -41,5 +61,6 @@ int main(int argc, char const *argv[]) {
 
     publisher<OctoString> downgrade_pub(DOWNGRADE_TOPIC, current_key++);
     subscriber<OctoString> upgrade_sub(UPGRADE_TOPIC, current_key - 1);
-    babysit_forever(&modules, &downgrade_pub, &upgrade_sub);
+    babysit_forever(&modules, &downgrade_pub, &upgrade_sub, config,
+                    current_key);
 }
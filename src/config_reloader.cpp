@@ -0,0 +1,179 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Reloads the octopOS config and enabled modules on change.
+ */
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <climits>
+#include <iostream>
+#include <list>
+#include <string>
+
+#include "../include/config_reloader.hpp"
+
+const int64_t RELOAD_DEBOUNCE_MS = 250;
+
+/** The events on the config's directory that may change the config.
+ *  Editors often save by writing a new file and renaming it over the
+ *  old one, so the directory is watched rather than the file.
+ */
+static const uint32_t CONFIG_EVENTS =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+/** The events on the modules directory that may change its modules.
+ *  IN_ATTRIB catches modules being made executable.
+ */
+static const uint32_t MODULES_EVENTS = CONFIG_EVENTS | IN_ATTRIB;
+
+static FilePath directory_of(const FilePath &path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static FilePath name_of(const FilePath &path) {
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+ConfigReloader::ConfigReloader(EventLoop *_loop, const FilePath &_config_path,
+                               const json &_config, MemKey _next_key,
+                               ModuleInfo *_modules,
+                               publisher<OctoString> *_downgrade_pub,
+                               RestartScheduler *_scheduler,
+                               Watchdog *_watchdog):
+    loop(_loop), config_path(_config_path), config(_config),
+    next_key(_next_key), modules(_modules), downgrade_pub(_downgrade_pub),
+    scheduler(_scheduler), watchdog(_watchdog), inotify_fd(-1),
+    config_dir_wd(-1),
+    modules_dir_wd(-1), reload_scheduled(false), reload_timer(0) { }
+
+ConfigReloader::~ConfigReloader() {
+    if (reload_scheduled) {
+        loop->cancel(reload_timer);
+    }
+    if (inotify_fd != -1) {
+        loop->unwatch(inotify_fd);
+        close(inotify_fd);
+    }
+}
+
+bool ConfigReloader::start() {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd == -1) {
+        return false;
+    }
+    config_dir_wd = inotify_add_watch(inotify_fd,
+                                      directory_of(config_path).c_str(),
+                                      CONFIG_EVENTS);
+    if (config_dir_wd == -1) {
+        return false;
+    }
+    if (config["modules_enabled"].is_string()) {
+        watch_modules_dir(config["modules_enabled"]);
+    }
+    return loop->watch(inotify_fd, [this]() { handle_events(); });
+}
+
+void ConfigReloader::watch_modules_dir(const FilePath &dir) {
+    if (modules_dir_wd != -1 && modules_dir_wd != config_dir_wd) {
+        inotify_rm_watch(inotify_fd, modules_dir_wd);
+    }
+    modules_dir = dir;
+    // A missing directory is not watched; a later config change that
+    // fixes it will be
+    modules_dir_wd = inotify_add_watch(inotify_fd, dir.c_str(),
+                                       MODULES_EVENTS);
+}
+
+void ConfigReloader::handle_events() {
+    // Big enough for at least one event with the longest name
+    char buffer[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    FilePath config_name = name_of(config_path);
+    bool changed = false;
+    ssize_t size;
+    while ((size = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + size;) {
+            struct inotify_event *event = (struct inotify_event*)p;  // NOLINT
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_IGNORED) {
+                // The watched directory went away
+                if (event->wd == modules_dir_wd) {
+                    modules_dir_wd = -1;
+                }
+                continue;
+            }
+            if (event->wd == modules_dir_wd) {
+                changed = true;
+            }
+            if (event->wd == config_dir_wd && event->len &&
+                config_name == event->name) {
+                changed = true;
+            }
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    // Wait for the burst of changes to settle before reloading
+    if (reload_scheduled) {
+        loop->cancel(reload_timer);
+    }
+    reload_scheduled = true;
+    reload_timer = loop->schedule(RELOAD_DEBOUNCE_MS, [this]() {
+        reload_scheduled = false;
+        reload();
+    });
+}
+
+// Modifies MODULES
+void ConfigReloader::reload() {
+    CDH::Optional<json> loaded = load(config_path);
+    if (loaded.isEmpty()) {
+        std::cerr << "Error: Unable to reload config at " << config_path
+                  << ". Keeping the current config." << std::endl;
+        return;
+    }
+    json fresh = loaded.get();
+    if (!fresh["modules_enabled"].is_string()) {
+        std::cerr << "Error: No modules_enabled directory in config at "
+                  << config_path << ". Keeping the current config."
+                  << std::endl;
+        return;
+    }
+    FilePath dir = fresh["modules_enabled"];
+    CDH::Optional< std::list<FilePath> > enabled = files_in(dir);
+    if (enabled.isEmpty()) {
+        // Don't retire every module just because the directory is
+        // briefly missing
+        std::cerr << "Error: Unable to read module path from config: " << dir
+                  << ". Keeping the current modules." << std::endl;
+        return;
+    }
+
+    ModuleDiff diff = diff_modules(*modules, enabled.get(), fresh);
+    next_key = apply_module_diff(diff, fresh, next_key, modules,
+                                 downgrade_pub, scheduler);
+    if (watchdog) {
+        watchdog->sync();
+    }
+    config = fresh;
+    if (dir != modules_dir || modules_dir_wd == -1) {
+        watch_modules_dir(dir);
+    }
+    if (!diff.added.empty() || !diff.removed.empty() ||
+        !diff.reconfigured.empty()) {
+        std::cout << "Reloaded config: " << diff.added.size() << " added, "
+                  << diff.removed.size() << " removed, "
+                  << diff.reconfigured.size() << " reconfigured"
+                  << std::endl;
+    }
+}
@@ -0,0 +1,216 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief An epoll-based event loop used by the octopOS driver to wait
+ * on child deaths, upgrade requests and timers without polling.
+ */
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../include/event_loop.hpp"
+
+/** The maximum number of events dispatched per `epoll_wait`. */
+static const int MAX_EVENTS_PER_WAKEUP = 64;
+
+EventLoop::EventLoop():
+    epoll_fd(-1), wake_fd(-1), timer_fd(-1), stopped(false),
+    timers(now_ms()) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (epoll_fd == -1 || wake_fd == -1 || timer_fd == -1) {
+        throw std::runtime_error("Unable to create event loop descriptors");
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+    ev.data.fd = timer_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+}
+
+EventLoop::~EventLoop() {
+    for (auto &sig : signal_fds) {
+        close(sig.second);
+    }
+    close(timer_fd);
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+bool EventLoop::watch(int fd, Callback on_readable) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    int op = fd_callbacks.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epoll_fd, op, fd, &ev) == -1) {
+        return false;
+    }
+    fd_callbacks[fd] = on_readable;
+    return true;
+}
+
+void EventLoop::unwatch(int fd) {
+    if (fd_callbacks.erase(fd)) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+}
+
+bool EventLoop::watch_signal(int signo, Callback on_signal) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    // Block in this thread too in case the caller forgot; other
+    // threads are the caller's responsibility.
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    int fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = watch(fd, [fd, on_signal]() {
+        // Signals of the same kind coalesce, so drain them all and
+        // notify once.
+        struct signalfd_siginfo info;
+        while (read(fd, &info, sizeof(info)) == sizeof(info)) { }
+        on_signal();
+    });
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    signal_fds[signo] = fd;
+    return true;
+}
+
+int64_t EventLoop::now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;  // NOLINT
+}
+
+TimerId EventLoop::schedule(int64_t delay_ms, Callback callback) {
+    int64_t now = now_ms();
+    if (timers.size() == 0) {
+        // Nothing can fire, so just let the idle wheel catch up
+        timers.advance(now);
+    }
+    TimerId id = timers.schedule(now + (delay_ms > 0 ? delay_ms : 0),
+                                 callback);
+    rearm_timer();
+    return id;
+}
+
+void EventLoop::cancel(TimerId id) {
+    if (timers.cancel(id)) {
+        rearm_timer();
+    }
+}
+
+// Arms the timerfd for the next time the timer wheel needs attention,
+// or disarms it when no timers are pending so that an idle loop never
+// wakes up.
+void EventLoop::rearm_timer() {
+    struct itimerspec spec = {};
+    CDH::Optional<int64_t> next = timers.next_deadline();
+    if (!next.isEmpty()) {
+        int64_t deadline = next.get();
+        // A zero it_value disarms the timer, so never arm for time 0
+        if (deadline <= 0) {
+            deadline = 1;
+        }
+        spec.it_value.tv_sec = deadline / 1000;
+        spec.it_value.tv_nsec = (deadline % 1000) * 1000000;
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void EventLoop::fire_timers() {
+    uint64_t expirations;
+    while (read(timer_fd, &expirations, sizeof(expirations)) > 0) { }
+    timers.advance(now_ms());
+    rearm_timer();
+}
+
+void EventLoop::post(Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex);
+        posted.push_back(callback);
+    }
+    wake();
+}
+
+void EventLoop::wake() {
+    uint64_t one = 1;
+    // The only possible failure is counter overflow, in which case the
+    // loop is already awake.
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::drain_posted() {
+    uint64_t count;
+    while (read(wake_fd, &count, sizeof(count)) > 0) { }
+
+    std::vector<Callback> work;
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex);
+        work.swap(posted);
+    }
+    for (Callback &callback : work) {
+        callback();
+    }
+}
+
+int EventLoop::run_once(int timeout_ms) {
+    struct epoll_event events[MAX_EVENTS_PER_WAKEUP];
+    int n = epoll_wait(epoll_fd, events, MAX_EVENTS_PER_WAKEUP, timeout_ms);
+    if (n == -1) {
+        // EINTR just means we were woken up early
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == wake_fd) {
+            drain_posted();
+        } else if (fd == timer_fd) {
+            fire_timers();
+        } else {
+            auto found = fd_callbacks.find(fd);
+            if (found != fd_callbacks.end()) {
+                // Copy, since the callback may unwatch itself
+                Callback callback = found->second;
+                callback();
+            }
+        }
+    }
+    return n;
+}
+
+void EventLoop::run() {
+    stopped = false;
+    while (!stopped) {
+        run_once(-1);
+    }
+}
+
+void EventLoop::stop() {
+    stopped = true;
+    wake();
+}
@@ -0,0 +1,246 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief A binary journal of supervisor events.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include "../include/journal.hpp"
+
+const char*  JOURNAL_PATH = "/var/log/octopOS/events.journal";
+const size_t JOURNAL_MAX_BYTES = 1024 * 1024;
+const size_t JOURNAL_QUEUE_CAPACITY = 1024;
+const int    JOURNAL_FLUSH_MS = 100;
+
+static std::atomic<Journal*> installed_journal(NULL);
+
+const char* journal_event_name(uint16_t event) {
+    switch (event) {
+    case JOURNAL_DRIVER_START: return "driver_start";
+    case JOURNAL_LAUNCH: return "launch";
+    case JOURNAL_LAUNCH_FAILED: return "launch_failed";
+    case JOURNAL_DEATH: return "death";
+    case JOURNAL_UNKNOWN_DEATH: return "unknown_death";
+    case JOURNAL_BACKOFF: return "backoff";
+    case JOURNAL_DOWNGRADE: return "downgrade";
+    case JOURNAL_UPGRADE: return "upgrade";
+    case JOURNAL_UPGRADE_IGNORED: return "upgrade_ignored";
+    case JOURNAL_KILL: return "kill";
+    case JOURNAL_HANG: return "hang";
+    case JOURNAL_RETIRE: return "retire";
+    default: return "unknown";
+    }
+}
+
+static bool valid_header(const JournalFileHeader &header, uint64_t capacity) {
+    return header.magic == JOURNAL_MAGIC &&
+           header.version == JOURNAL_VERSION &&
+           header.record_size == sizeof(JournalRecord) &&
+           header.capacity == capacity;
+}
+
+static uint64_t capacity_for(size_t bytes) {
+    if (bytes < sizeof(JournalFileHeader) + sizeof(JournalRecord)) {
+        return 0;
+    }
+    return (bytes - sizeof(JournalFileHeader)) / sizeof(JournalRecord);
+}
+
+Journal::Journal():
+    cells(new Cell[JOURNAL_QUEUE_CAPACITY]),
+    mask(JOURNAL_QUEUE_CAPACITY - 1), tail(0), head(0), dropped_records(0),
+    fd(-1), size(0), header(NULL), records(NULL), stopping(false) {
+    for (size_t i = 0; i < JOURNAL_QUEUE_CAPACITY; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+Journal::~Journal() {
+    if (installed_journal.load() == this) {
+        set_journal(NULL);
+    }
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            stopping = true;
+        }
+        wakeup.notify_one();
+        flusher.join();
+    }
+    flush();
+    close();
+}
+
+bool Journal::open(const FilePath &path, size_t max_bytes) {
+    uint64_t capacity = capacity_for(max_bytes);
+    if (is_open() || capacity == 0) {
+        return false;
+    }
+    // Modules must not inherit the journal
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    size = sizeof(JournalFileHeader) + capacity * sizeof(JournalRecord);
+    struct stat st;
+    bool reuse = fstat(fd, &st) == 0 && (size_t)st.st_size == size;
+    if (!reuse && ftruncate(fd, size) == -1) {
+        close();
+        return false;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close();
+        return false;
+    }
+    header = static_cast<JournalFileHeader*>(map);
+    records = reinterpret_cast<JournalRecord*>(header + 1);
+    if (!reuse || !valid_header(*header, capacity)) {
+        memset(header, 0, sizeof(JournalFileHeader));
+        header->magic = JOURNAL_MAGIC;
+        header->version = JOURNAL_VERSION;
+        header->record_size = sizeof(JournalRecord);
+        header->capacity = capacity;
+    }
+    record(JOURNAL_DRIVER_START, JOURNAL_NO_SLOT, getpid());
+    flusher = std::thread(&Journal::flush_forever, this);
+    return true;
+}
+
+void Journal::close() {
+    if (header) {
+        munmap(header, size);
+        header = NULL;
+        records = NULL;
+    }
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+// A bounded MPMC queue (Vyukov's) with a single consumer: producers
+// claim a position by advancing `tail`, and publish the record by
+// bumping the cell's sequence, so the drainer never sees a half
+// written record
+bool Journal::record(JournalEvent event, uint32_t slot, pid_t pid,
+                     int32_t status) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (1) {
+        cell = &cells[pos & mask];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t lag = (int64_t)(sequence - pos);
+        if (lag == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // Full: the flusher is behind, and waiting for it would put
+            // I/O on the caller's path
+            dropped_records.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell->record.time_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+    cell->record.slot = slot;
+    cell->record.pid = pid;
+    cell->record.status = status;
+    cell->record.event = event;
+    cell->record.reserved = 0;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+// Must hold DRAIN_MUTEX
+size_t Journal::drain() {
+    if (!is_open()) {
+        return 0;
+    }
+    size_t drained = 0;
+    while (1) {
+        Cell &cell = cells[head & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != head + 1) {
+            break;
+        }
+        records[header->written % header->capacity] = cell.record;
+        header->written++;
+        cell.sequence.store(head + mask + 1, std::memory_order_release);
+        head++;
+        drained++;
+    }
+    header->dropped = dropped_records.load(std::memory_order_relaxed);
+    return drained;
+}
+
+void Journal::flush() {
+    std::lock_guard<std::mutex> lock(drain_mutex);
+    drain();
+    if (is_open()) {
+        msync(header, size, MS_SYNC);
+    }
+}
+
+void Journal::flush_forever() {
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    while (!stopping) {
+        wakeup.wait_for(lock, std::chrono::milliseconds(JOURNAL_FLUSH_MS));
+        std::lock_guard<std::mutex> drain_lock(drain_mutex);
+        if (drain()) {
+            // The page cache already survives the driver crashing;
+            // this starts writeback so that it survives a reset too
+            msync(header, size, MS_ASYNC);
+        }
+    }
+}
+
+void set_journal(Journal *journal) {
+    installed_journal.store(journal);
+}
+
+void journal_event(JournalEvent event, ModuleSlot slot, pid_t pid,
+                   int32_t status) {
+    Journal *journal = installed_journal.load(std::memory_order_acquire);
+    if (journal) {
+        journal->record(event, slot, pid, status);
+    }
+}
+
+CDH::Optional< std::vector<JournalRecord> > read_journal(const FilePath &path) {
+    std::ifstream in(path, std::ios::binary);
+    JournalFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.capacity == 0 || !valid_header(header, header.capacity)) {
+        return None< std::vector<JournalRecord> >();
+    }
+    std::vector<JournalRecord> ring(header.capacity);
+    if (!in.read(reinterpret_cast<char*>(&ring[0]),
+                 header.capacity * sizeof(JournalRecord))) {
+        return None< std::vector<JournalRecord> >();
+    }
+    std::vector<JournalRecord> records;
+    uint64_t first = header.written > header.capacity ?
+        header.written - header.capacity : 0;
+    for (uint64_t i = first; i < header.written; i++) {
+        records.push_back(ring[i % header.capacity]);
+    }
+    return Just(records);
+}
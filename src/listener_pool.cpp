@@ -0,0 +1,159 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief A fixed pool of worker threads serving many tentacles.
+ */
+
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "../include/listener_pool.hpp"
+
+/** The most workers started by default. */
+static const unsigned MAX_DEFAULT_WORKERS = 4;
+
+const size_t ListenerPool::SERVE_BUDGET;
+const int ListenerPool::MIN_IDLE_MS;
+const int ListenerPool::MAX_IDLE_MS;
+
+static unsigned default_workers() {
+    return std::min(std::max(std::thread::hardware_concurrency(), 1u),
+                    MAX_DEFAULT_WORKERS);
+}
+
+ListenerPool::ListenerPool(size_t max_tentacles, unsigned workers):
+    serves(max_tentacles), shards(workers ? workers : default_workers()),
+    stopping(false), served_tentacles(0), served_messages(0) {
+    for (Shard &shard : shards) {
+        shard.notified = false;
+        shard.tentacles.reserve(max_tentacles / shards.size() + 1);
+    }
+    for (Shard &shard : shards) {
+        shard.thread = std::thread(&ListenerPool::work, this, &shard);
+    }
+}
+
+ListenerPool::~ListenerPool() {
+    stopping = true;
+    for (Shard &shard : shards) {
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.notified = true;
+        }
+        shard.wakeup.notify_one();
+    }
+    for (Shard &shard : shards) {
+        shard.thread.join();
+    }
+}
+
+bool ListenerPool::add(int tentacle, Serve serve) {
+    if (tentacle < 0 || (size_t)tentacle >= serves.size() || !serve) {
+        return false;
+    }
+    Shard &shard = shard_of(tentacle);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (serves[tentacle]) {
+            return false;
+        }
+        serves[tentacle] = serve;
+        shard.tentacles.push_back(tentacle);
+        shard.notified = true;
+    }
+    served_tentacles++;
+    shard.wakeup.notify_one();
+    return true;
+}
+
+bool ListenerPool::remove(int tentacle) {
+    if (tentacle < 0 || (size_t)tentacle >= serves.size()) {
+        return false;
+    }
+    Shard &shard = shard_of(tentacle);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!serves[tentacle]) {
+        return false;
+    }
+    serves[tentacle] = Serve();
+    shard.tentacles.erase(std::find(shard.tentacles.begin(),
+                                    shard.tentacles.end(), tentacle));
+    served_tentacles--;
+    return true;
+}
+
+void ListenerPool::notify(int tentacle) {
+    if (tentacle < 0 || (size_t)tentacle >= serves.size()) {
+        return;
+    }
+    Shard &shard = shard_of(tentacle);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.notified = true;
+    }
+    shard.wakeup.notify_one();
+}
+
+// Serve functions run with the shard locked, which is what lets
+// `remove` promise that a removed serve function is never running.
+// They're non-blocking and bounded by SERVE_BUDGET, so `add`, `remove`
+// and `notify` only ever wait for one short sweep.
+void ListenerPool::work(Shard *shard) {
+    int idle_ms = MIN_IDLE_MS;
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    while (!stopping) {
+        shard->notified = false;
+        size_t handled = 0;
+        for (int tentacle : shard->tentacles) {
+            handled += serves[tentacle](tentacle, SERVE_BUDGET);
+        }
+        if (handled) {
+            served_messages += handled;
+            idle_ms = MIN_IDLE_MS;
+            // Let `add` and `remove` in between sweeps under load
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+            continue;
+        }
+        if (!shard->notified) {
+            shard->wakeup.wait_for(lock, std::chrono::milliseconds(idle_ms));
+            idle_ms = std::min(idle_ms * 2, MAX_IDLE_MS);
+        }
+    }
+}
+
+ListenerPool::Serve serve_message_queue(
+    int msqid, size_t max_size,
+    std::function<void(int tentacle, long type,  // NOLINT
+                       const char *body, size_t size)> handle) {
+    // struct msgbuf is a long followed by the body
+    std::shared_ptr<std::vector<char> > buffer =
+        std::make_shared<std::vector<char> >(sizeof(long) + max_size);  // NOLINT
+    return [msqid, max_size, handle, buffer](int tentacle, size_t budget) {
+        size_t handled = 0;
+        char *message = &(*buffer)[0];
+        while (handled < budget) {
+            ssize_t size = msgrcv(msqid, message, max_size, 0,
+                                  IPC_NOWAIT | MSG_NOERROR);
+            if (size < 0) {
+                break;
+            }
+            long type;  // NOLINT
+            std::copy(message, message + sizeof(type),
+                      reinterpret_cast<char*>(&type));
+            handle(tentacle, type, message + sizeof(type), size);
+            handled++;
+        }
+        return handled;
+    };
+}
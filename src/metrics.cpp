@@ -0,0 +1,270 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Counters and latency histograms of the driver.
+ */
+
+#include <time.h>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "../include/metrics.hpp"
+#include "../include/module_resources.hpp"
+
+/** The quantiles written for each histogram. */
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+int64_t metrics_now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+LatencyHistogram::LatencyHistogram(): total(0), sum_us(0), max_us(0) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Values below 2^SUB_BUCKET_BITS get a bucket each. Above that, each
+// power of two is split into 2^SUB_BUCKET_BITS equal buckets, indexed
+// by the bits just below the most significant one
+size_t LatencyHistogram::bucket_of(uint64_t value) {
+    const uint64_t sub_buckets = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+    if (value < sub_buckets) {
+        return value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    size_t sub = (value >> shift) - sub_buckets;
+    return ((size_t)(shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + sub;
+}
+
+uint64_t LatencyHistogram::upper_bound_of(size_t bucket) {
+    const uint64_t sub_buckets = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    int shift = (bucket >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    uint64_t sub = bucket & (sub_buckets - 1);
+    uint64_t lower = (sub_buckets + sub) << shift;
+    return lower + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::record(int64_t us) {
+    uint64_t value = us > 0 ? us : 0;
+    buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(value, std::memory_order_relaxed);
+    uint64_t seen = max_us.load(std::memory_order_relaxed);
+    while (value > seen &&
+           !max_us.compare_exchange_weak(seen, value,
+                                         std::memory_order_relaxed)) { }
+}
+
+// Concurrent records may be half counted, which only skews a quantile
+// by the records in flight
+uint64_t LatencyHistogram::quantile(double q) const {
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)std::ceil(q * n);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t bound = upper_bound_of(i);
+            return bound < max() ? bound : max();
+        }
+    }
+    return max();
+}
+
+SupervisorMetrics& supervisor_metrics() {
+    static SupervisorMetrics metrics;
+    return metrics;
+}
+
+static std::string seconds(uint64_t us) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6f", us / 1e6);
+    return buffer;
+}
+
+// Escapes a label value as the text format requires
+static std::string label(const std::string &value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static void write_header(std::ostream &out, const char *name,
+                         const char *type, const char *help) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n";
+}
+
+static void write_counter(std::ostream &out, const char *name,
+                          const char *help, const Counter &counter) {
+    write_header(out, name, "counter", help);
+    out << name << " " << counter.get() << "\n";
+}
+
+static void write_histogram(std::ostream &out, const char *name,
+                            const char *help,
+                            const LatencyHistogram &histogram) {
+    write_header(out, name, "summary", help);
+    for (double q : QUANTILES) {
+        out << name << "{quantile=\"" << q << "\"} "
+            << seconds(histogram.quantile(q)) << "\n";
+    }
+    out << name << "_sum " << seconds(histogram.sum()) << "\n"
+        << name << "_count " << histogram.count() << "\n"
+        << name << "_max " << seconds(histogram.max()) << "\n";
+}
+
+void write_metrics(std::ostream &out, const SupervisorMetrics &metrics,
+                   const ModuleRegistry *modules) {
+    write_counter(out, "octopos_spawns_total", "Modules started.",
+                  metrics.spawns);
+    write_counter(out, "octopos_spawn_failures_total",
+                  "Modules that couldn't be started.",
+                  metrics.spawn_failures);
+    write_counter(out, "octopos_restarts_total",
+                  "Relaunches of modules that died or were upgraded.",
+                  metrics.restarts);
+    write_counter(out, "octopos_deaths_total", "Deaths of modules.",
+                  metrics.deaths);
+    write_counter(out, "octopos_unknown_deaths_total",
+                  "Deaths of children that aren't modules.",
+                  metrics.unknown_deaths);
+    write_counter(out, "octopos_backoffs_total",
+                  "Restarts delayed by backoff.", metrics.backoffs);
+    write_counter(out, "octopos_downgrades_total", "Downgrades requested.",
+                  metrics.downgrades);
+    write_counter(out, "octopos_upgrade_requests_total",
+                  "Upgrade requests received.", metrics.upgrade_requests);
+    write_counter(out, "octopos_upgrades_total", "Upgrades started.",
+                  metrics.upgrades);
+    write_counter(out, "octopos_hangs_total",
+                  "Modules killed for missing their heartbeat deadline.",
+                  metrics.hangs);
+    write_header(out, "octopos_listener_threads", "gauge",
+                 "Tentacle listener threads.");
+    out << "octopos_listener_threads " << metrics.listeners.get() << "\n";
+
+    write_histogram(out, "octopos_spawn_duration_seconds",
+                    "Time to spawn one module.", metrics.spawn_us);
+    write_histogram(out, "octopos_downtime_seconds",
+                    "Time from a module dying to running again.",
+                    metrics.downtime_us);
+    write_histogram(out, "octopos_reap_duration_seconds",
+                    "Time to handle one batch of deaths.", metrics.reap_us);
+    write_histogram(out, "octopos_upgrade_wait_seconds",
+                    "Time from receiving an upgrade request to handling it.",
+                    metrics.upgrade_wait_us);
+    write_histogram(out, "octopos_upgrade_duration_seconds",
+                    "Time to handle one batch of upgrade requests.",
+                    metrics.upgrade_us);
+
+    if (!modules) {
+        return;
+    }
+    size_t running = 0, down = 0, downgraded = 0, retired = 0;
+    for (ModuleSlot slot = 0; slot < modules->size(); slot++) {
+        const Module &module = modules->at(slot);
+        if (module.retired) {
+            retired++;
+        } else if (module.downgrade_requested) {
+            downgraded++;
+        } else if (module.pid > 0) {
+            running++;
+        } else {
+            down++;
+        }
+    }
+    write_header(out, "octopos_modules", "gauge", "Modules by state.");
+    out << "octopos_modules{state=\"running\"} " << running << "\n"
+        << "octopos_modules{state=\"down\"} " << down << "\n"
+        << "octopos_modules{state=\"downgraded\"} " << downgraded << "\n"
+        << "octopos_modules{state=\"retired\"} " << retired << "\n";
+
+    write_header(out, "octopos_module_deaths_total", "counter",
+                 "Deaths of each module.");
+    for (ModuleSlot slot = 0; slot < modules->size(); slot++) {
+        out << "octopos_module_deaths_total{module=\""
+            << label(modules->path_of(slot)) << "\"} "
+            << modules->at(slot).death_count << "\n";
+    }
+    write_header(out, "octopos_module_cpu_seconds_total", "counter",
+                 "CPU time used by the finished runs of each module.");
+    for (ModuleSlot slot = 0; slot < modules->size(); slot++) {
+        out << "octopos_module_cpu_seconds_total{module=\""
+            << label(modules->path_of(slot)) << "\"} "
+            << seconds(modules->at(slot).cpu_time_us) << "\n";
+    }
+
+    // Modules with resource limits also report their cgroup's usage
+    std::vector< std::pair<ModuleSlot, CgroupUsage> > usages;
+    for (ModuleSlot slot = 0; slot < modules->size(); slot++) {
+        const FilePath &cgroup = modules->at(slot).cgroup;
+        if (cgroup.empty()) {
+            continue;
+        }
+        CDH::Optional<CgroupUsage> usage = read_cgroup_usage(cgroup);
+        if (!usage.isEmpty()) {
+            usages.push_back(std::make_pair(slot, usage.get()));
+        }
+    }
+    if (usages.empty()) {
+        return;
+    }
+    write_header(out, "octopos_cgroup_cpu_seconds_total", "counter",
+                 "CPU time used by each module's cgroup.");
+    for (size_t i = 0; i < usages.size(); i++) {
+        out << "octopos_cgroup_cpu_seconds_total{module=\""
+            << label(modules->path_of(usages[i].first)) << "\"} "
+            << seconds(usages[i].second.cpu_usage_us) << "\n";
+    }
+    write_header(out, "octopos_cgroup_throttled_seconds_total", "counter",
+                 "Time each module's cgroup was throttled by cpu.max.");
+    for (size_t i = 0; i < usages.size(); i++) {
+        out << "octopos_cgroup_throttled_seconds_total{module=\""
+            << label(modules->path_of(usages[i].first)) << "\"} "
+            << seconds(usages[i].second.cpu_throttled_us) << "\n";
+    }
+    write_header(out, "octopos_cgroup_memory_bytes", "gauge",
+                 "Memory used by each module's cgroup.");
+    for (size_t i = 0; i < usages.size(); i++) {
+        out << "octopos_cgroup_memory_bytes{module=\""
+            << label(modules->path_of(usages[i].first)) << "\"} "
+            << usages[i].second.memory_bytes << "\n";
+    }
+    write_header(out, "octopos_cgroup_oom_kills_total", "counter",
+                 "Processes killed for exceeding memory.max.");
+    for (size_t i = 0; i < usages.size(); i++) {
+        out << "octopos_cgroup_oom_kills_total{module=\""
+            << label(modules->path_of(usages[i].first)) << "\"} "
+            << usages[i].second.oom_kills << "\n";
+    }
+}
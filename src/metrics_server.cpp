@@ -0,0 +1,78 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Serves the driver's metrics on a Unix domain socket.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "../include/metrics_server.hpp"
+
+const char* METRICS_SOCKET_PATH = "/run/octopOS/metrics.sock";
+
+/** The most connections waiting to be served. */
+static const int METRICS_BACKLOG = 8;
+
+MetricsServer::MetricsServer(EventLoop *_loop,
+                             const ModuleRegistry *_modules):
+    loop(_loop), modules(_modules), listen_fd(-1) { }
+
+MetricsServer::~MetricsServer() {
+    if (listen_fd != -1) {
+        loop->unwatch(listen_fd);
+        close(listen_fd);
+        unlink(path.c_str());
+    }
+}
+
+bool MetricsServer::start(const FilePath &_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (_path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    strncpy(address.sun_path, _path.c_str(), sizeof(address.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        return false;
+    }
+    path = _path;
+    // A driver that crashed leaves its socket behind
+    unlink(path.c_str());
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) == -1 ||
+        listen(listen_fd, METRICS_BACKLOG) == -1 ||
+        !loop->watch(listen_fd, [this]() { serve(); })) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Runs on the loop, which owns MODULES. The text is about 100 bytes
+// per module, which fits in a fresh socket's buffer, so sending doesn't
+// block; if it ever doesn't, the reader gets it truncated rather than
+// the loop stalling
+void MetricsServer::serve() {
+    int fd;
+    while ((fd = accept4(listen_fd, NULL, NULL,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        std::ostringstream text;
+        write_metrics(text, supervisor_metrics(), modules);
+        std::string body = text.str();
+        send(fd, body.data(), body.size(), MSG_NOSIGNAL);
+        close(fd);
+    }
+}
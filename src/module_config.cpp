@@ -0,0 +1,114 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Per-module settings read from the octopOS config.
+ */
+
+#include <string>
+
+#include "../include/module_config.hpp"
+
+const time_t RUNTIME_CUTOFF_DOWNGRADE_S = 5*60;
+const int    DEATH_COUNT_CUTOFF_DOWNGRADE = 5;
+const int64_t WATCHDOG_STARTUP_GRACE_MS = 10 * 1000;
+const char*  CGROUP_ROOT = "/sys/fs/cgroup/octopOS";
+
+RestartPolicy::RestartPolicy():
+    initial_delay_ms(100), multiplier(2.0), jitter(0.2),
+    max_delay_ms(60 * 1000), runtime_cutoff_s(RUNTIME_CUTOFF_DOWNGRADE_S),
+    death_count_cutoff(DEATH_COUNT_CUTOFF_DOWNGRADE) { }
+
+bool RestartPolicy::operator==(const RestartPolicy &other) const {
+    return initial_delay_ms == other.initial_delay_ms &&
+        multiplier == other.multiplier && jitter == other.jitter &&
+        max_delay_ms == other.max_delay_ms &&
+        runtime_cutoff_s == other.runtime_cutoff_s &&
+        death_count_cutoff == other.death_count_cutoff;
+}
+
+WatchdogPolicy::WatchdogPolicy():
+    timeout_ms(0), startup_grace_ms(WATCHDOG_STARTUP_GRACE_MS) { }
+
+ResourcePolicy::ResourcePolicy():
+    cpu_max_percent(0), memory_max_kb(0), nice(0), io_priority(4),
+    cgroup_root(CGROUP_ROOT) { }
+
+bool ResourcePolicy::operator==(const ResourcePolicy &other) const {
+    return cpu_max_percent == other.cpu_max_percent &&
+        memory_max_kb == other.memory_max_kb && cpus == other.cpus &&
+        nice == other.nice && io_class == other.io_class &&
+        io_priority == other.io_priority && cgroup_root == other.cgroup_root;
+}
+
+// Overrides the settings in CONFIG with those present in SETTINGS
+void apply_module_settings(const json &settings, ModuleConfig *config) {
+    const json &restart = settings["restart"];
+    RestartPolicy &policy = config->restart;
+    policy.initial_delay_ms =
+        restart.value("initial_delay_ms", policy.initial_delay_ms);
+    policy.multiplier = restart.value("multiplier", policy.multiplier);
+    policy.jitter = restart.value("jitter", policy.jitter);
+    policy.max_delay_ms = restart.value("max_delay_ms", policy.max_delay_ms);
+    policy.runtime_cutoff_s =
+        restart.value("runtime_cutoff_s", policy.runtime_cutoff_s);
+    policy.death_count_cutoff =
+        restart.value("death_count_cutoff", policy.death_count_cutoff);
+
+    const json &watchdog = settings["watchdog"];
+    config->watchdog.timeout_ms =
+        watchdog.value("timeout_ms", config->watchdog.timeout_ms);
+    config->watchdog.startup_grace_ms =
+        watchdog.value("startup_grace_ms", config->watchdog.startup_grace_ms);
+
+    const json &resources = settings["resources"];
+    ResourcePolicy &limits = config->resources;
+    limits.cpu_max_percent =
+        resources.value("cpu_max_percent", limits.cpu_max_percent);
+    limits.memory_max_kb =
+        resources.value("memory_max_kb", limits.memory_max_kb);
+    if (resources["cpus"].is_array()) {
+        limits.cpus.clear();
+        for (size_t i = 0; i < resources["cpus"].size(); i++) {
+            int cpu;
+            if (resources["cpus"][i].convert_to(&cpu) && cpu >= 0) {
+                limits.cpus.push_back(cpu);
+            }
+        }
+    }
+    limits.nice = resources.value("nice", limits.nice);
+    limits.io_class = resources.value("io_class", limits.io_class);
+    limits.io_priority = resources.value("io_priority", limits.io_priority);
+    limits.cgroup_root = resources.value("cgroup_root", limits.cgroup_root);
+}
+
+ModuleConfig module_config_for(const json &config, const std::string &module) {
+    ModuleConfig result;
+    apply_module_settings(config["module_defaults"], &result);
+
+    // Modules are configured by executable name, not by full path, so
+    // that moving the modules directory doesn't lose their settings
+    std::string name = module.substr(module.find_last_of('/') + 1);
+    apply_module_settings(config["modules"][name], &result);
+    return result;
+}
+
+int64_t restart_delay_ms(const RestartPolicy &policy, int early_death_count,
+                         double random_unit) {
+    if (early_death_count <= 1) {
+        return 0;
+    }
+    double delay = policy.initial_delay_ms;
+    for (int i = 2; i < early_death_count && delay < policy.max_delay_ms; i++) {
+        delay *= policy.multiplier;
+    }
+    if (delay > policy.max_delay_ms) {
+        delay = policy.max_delay_ms;
+    }
+    delay *= 1 + policy.jitter * (2 * random_unit - 1);
+    return delay > 0 ? (int64_t)delay : 0;  // NOLINT
+}
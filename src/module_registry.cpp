@@ -0,0 +1,94 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief The registry of modules managed by the octopOS driver.
+ */
+
+#include "../include/module_registry.hpp"
+
+ModuleRegistry::ModuleRegistry(
+        std::initializer_list< std::pair<FilePath, Module> > init) {
+    for (const std::pair<FilePath, Module> &entry : init) {
+        add(entry.first, entry.second);
+    }
+}
+
+ModuleSlot ModuleRegistry::add(const FilePath &path, const Module &module) {
+    ModuleSlot slot;
+    auto found = by_path.find(path);
+    if (found == by_path.end()) {
+        slot = modules.size();
+        modules.push_back(module);
+        paths.push_back(path);
+        indexed_pids.push_back(-1);
+        by_path[path] = slot;
+    } else {
+        slot = found->second;
+        modules[slot] = module;
+    }
+    update_pid_index(slot);
+    return slot;
+}
+
+ModuleSlot ModuleRegistry::intern(const FilePath &path) {
+    auto found = by_path.find(path);
+    if (found == by_path.end()) {
+        return add(path, Module());
+    }
+    return found->second;
+}
+
+Module& ModuleRegistry::operator[](const FilePath &path) {
+    return modules[intern(path)];
+}
+
+CDH::Optional<ModuleSlot> ModuleRegistry::slot_of(const FilePath &path) const {
+    auto found = by_path.find(path);
+    if (found == by_path.end()) {
+        return None<ModuleSlot>();
+    }
+    return Just(found->second);
+}
+
+CDH::Optional<ModuleSlot> ModuleRegistry::slot_with(pid_t pid) const {
+    auto found = by_pid.find(pid);
+    if (found != by_pid.end() && modules[found->second].pid == pid) {
+        return Just(found->second);
+    }
+    // The index is stale: some pid was changed without a reindex.
+    // Find it the slow way and repair the index as we go.
+    for (ModuleSlot slot = 0; slot < modules.size(); slot++) {
+        if (indexed_pids[slot] != modules[slot].pid) {
+            update_pid_index(slot);
+        }
+    }
+    found = by_pid.find(pid);
+    if (found != by_pid.end() && modules[found->second].pid == pid) {
+        return Just(found->second);
+    }
+    return None<ModuleSlot>();
+}
+
+void ModuleRegistry::reindex(ModuleSlot slot) {
+    update_pid_index(slot);
+}
+
+void ModuleRegistry::update_pid_index(ModuleSlot slot) const {
+    pid_t old_pid = indexed_pids[slot];
+    if (old_pid > 0) {
+        auto found = by_pid.find(old_pid);
+        if (found != by_pid.end() && found->second == slot) {
+            by_pid.erase(found);
+        }
+    }
+    pid_t new_pid = modules[slot].pid;
+    indexed_pids[slot] = new_pid;
+    if (new_pid > 0) {
+        by_pid[new_pid] = slot;
+    }
+}
@@ -0,0 +1,163 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Per-module cgroups, scheduling and I/O priorities.
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../include/module_resources.hpp"
+
+const int64_t CGROUP_CPU_PERIOD_US = 100000;
+
+/** The I/O scheduling classes of ioprio_set(2), by config name. */
+static const char* const IO_CLASSES[] = {"", "realtime", "best-effort",
+                                         "idle"};
+static const int IOPRIO_CLASS_SHIFT = 13;
+
+// Writes VALUE to the cgroup interface file at PATH. The newline makes
+// an empty value a write too, which resets the file.
+static bool write_file(const FilePath &path, const std::string &value) {
+    std::ofstream out(path);
+    out << value << "\n";
+    out.flush();
+    return out.good();
+}
+
+static std::string cpu_list(const std::vector<int> &cpus) {
+    std::ostringstream list;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        list << (i ? "," : "") << cpus[i];
+    }
+    return list.str();
+}
+
+FilePath module_cgroup_path(const FilePath &module,
+                            const ResourcePolicy &policy) {
+    // Named like the module's settings, after its executable; the
+    // prefix keeps it clear of the cgroup's interface files
+    return policy.cgroup_root + "/module." +
+        module.substr(module.find_last_of('/') + 1);
+}
+
+bool prepare_module_cgroup(const FilePath &cgroup,
+                           const ResourcePolicy &policy) {
+    if (mkdir(policy.cgroup_root.c_str(), 0755) == -1 && errno != EEXIST) {
+        return false;
+    }
+    if (mkdir(cgroup.c_str(), 0755) == 0) {
+        // Controllers are enabled one at a time, so that one the
+        // kernel lacks doesn't stop the others
+        const char *controllers[] = {"+cpu", "+memory", "+cpuset"};
+        for (const char *controller : controllers) {
+            write_file(policy.cgroup_root + "/cgroup.subtree_control",
+                       controller);
+        }
+    } else if (errno != EEXIST) {
+        return false;
+    }
+
+    // Limits that aren't set are reset, in case they were before; only
+    // those that are set must work, so that a controller that isn't
+    // needed may be missing
+    std::string cpu_max = "max";
+    if (policy.cpu_max_percent > 0) {
+        int64_t quota = policy.cpu_max_percent * CGROUP_CPU_PERIOD_US / 100;
+        cpu_max = std::to_string(quota > 1000 ? quota : 1000);
+    }
+    bool cpu_ok = write_file(cgroup + "/cpu.max", cpu_max + " " +
+                             std::to_string(CGROUP_CPU_PERIOD_US));
+    bool memory_ok = write_file(cgroup + "/memory.max",
+                                policy.memory_max_kb > 0 ?
+                                std::to_string(policy.memory_max_kb * 1024) :
+                                "max");
+    bool cpus_ok = write_file(cgroup + "/cpuset.cpus", cpu_list(policy.cpus));
+    return (cpu_ok || policy.cpu_max_percent <= 0) &&
+        (memory_ok || policy.memory_max_kb <= 0) &&
+        (cpus_ok || policy.cpus.empty());
+}
+
+void remove_module_cgroup(const FilePath &cgroup) {
+    rmdir(cgroup.c_str());
+}
+
+SpawnOptions spawn_options_for(const FilePath &module,
+                               const ResourcePolicy &policy) {
+    SpawnOptions options;
+    options.nice = policy.nice;
+    for (int cpu : policy.cpus) {
+        if (cpu < CPU_SETSIZE) {
+            options.cpus.push_back(cpu);
+        } else {
+            std::cerr << "Error: No CPU " << cpu << " for module " << module
+                      << "." << std::endl;
+        }
+    }
+    if (!policy.io_class.empty()) {
+        int io_class = 0;
+        for (int i = 1; i < 4; i++) {
+            if (policy.io_class == IO_CLASSES[i]) {
+                io_class = i;
+            }
+        }
+        if (!io_class || policy.io_priority < 0 || policy.io_priority > 7) {
+            std::cerr << "Error: Invalid I/O priority " << policy.io_class
+                      << " " << policy.io_priority << " for module "
+                      << module << "." << std::endl;
+        } else {
+            options.ioprio =
+                (io_class << IOPRIO_CLASS_SHIFT) | policy.io_priority;
+        }
+    }
+    if (policy.needs_cgroup()) {
+        FilePath cgroup = module_cgroup_path(module, policy);
+        if (prepare_module_cgroup(cgroup, policy)) {
+            options.cgroup = cgroup;
+        } else {
+            std::cerr << "Error: Unable to set up cgroup " << cgroup
+                      << " for module " << module << ". It will run "
+                      << "without resource limits." << std::endl;
+        }
+    }
+    return options;
+}
+
+// Reads the value of KEY from a flat-keyed cgroup file, e.g. cpu.stat
+static bool read_key(const FilePath &path, const std::string &key,
+                     uint64_t *value) {
+    std::ifstream in(path);
+    std::string name;
+    uint64_t number;
+    while (in >> name >> number) {
+        if (name == key) {
+            *value = number;
+            return true;
+        }
+    }
+    return false;
+}
+
+CDH::Optional<CgroupUsage> read_cgroup_usage(const FilePath &cgroup) {
+    CgroupUsage usage = {0, 0, 0, 0};
+    if (!read_key(cgroup + "/cpu.stat", "usage_usec", &usage.cpu_usage_us)) {
+        return None<CgroupUsage>();
+    }
+    // The others are missing without the cpu and memory controllers
+    read_key(cgroup + "/cpu.stat", "throttled_usec", &usage.cpu_throttled_us);
+    std::ifstream(cgroup + "/memory.current") >> usage.memory_bytes;
+    read_key(cgroup + "/memory.events", "oom_kill", &usage.oom_kills);
+    return Just(usage);
+}
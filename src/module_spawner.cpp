@@ -0,0 +1,301 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Launches module processes without forking the driver.
+ */
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <spawn.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/metrics.hpp"
+#include "../include/module_spawner.hpp"
+
+extern char **environ;
+
+/** See clone3(2). Defined here since older kernel headers lack it. */
+static const uint64_t CLONE_INTO_CGROUP_FLAG = 0x200000000ULL;
+/** The arguments of clone3(2), up to `cgroup` (Linux 5.7). */
+struct CloneArgs {
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t child_tid;
+    uint64_t parent_tid;
+    uint64_t exit_signal;
+    uint64_t stack;
+    uint64_t stack_size;
+    uint64_t tls;
+    uint64_t set_tid;
+    uint64_t set_tid_size;
+    uint64_t cgroup;
+};
+/** See ioprio_set(2); glibc has no header for it. */
+static const int IOPRIO_WHO_PROCESS = 1;
+
+/** The default upper bound on spawning threads. Spawning is mostly
+ *  kernel work (exec, mapping the binary), so a few threads are enough
+ *  to overlap it.
+ */
+static const unsigned DEFAULT_MAX_SPAWN_THREADS = 8;
+
+// Resets what a module shouldn't inherit from the driver: its blocked
+// SIGCHLD and any signals it ignores. Async-signal-safe, for children
+// of the cloned path.
+static void reset_signals(const sigset_t &mask) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    for (int signo = 1; signo < NSIG; signo++) {
+        sigaction(signo, &action, NULL);
+    }
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+}
+
+// Clones the calling process into the cgroup open at CGROUP_FD. Sets
+// PLACED to whether the child started there; if not, it must move
+// itself.
+static pid_t clone_into_cgroup(int cgroup_fd, bool *placed) {
+    *placed = false;
+#ifdef SYS_clone3
+    if (cgroup_fd != -1) {
+        CloneArgs args;
+        memset(&args, 0, sizeof(args));
+        args.flags = CLONE_INTO_CGROUP_FLAG;
+        args.exit_signal = SIGCHLD;
+        args.cgroup = cgroup_fd;
+        long pid = syscall(SYS_clone3, &args, sizeof(args));  // NOLINT
+        if (pid != -1) {
+            *placed = true;
+            return pid;
+        }
+        // Otherwise the kernel is too old for clone3 or the flag, or
+        // refused the cgroup; the child's write to cgroup.procs will
+        // tell which
+    }
+#endif
+    return fork();
+}
+
+// The child may only make async-signal-safe calls: the driver has
+// other threads, whose locks it may have copied held. So everything it
+// needs is prepared here first, and it reports failure through a
+// close-on-exec pipe, which is closed without a word when exec works.
+static pid_t spawn_cloned(const FilePath &module, MemKey key,
+                          const SpawnOptions &options) {
+    std::string key_arg = std::to_string(key);
+    char *argv[] = {&key_arg[0], NULL};
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : options.cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    int cgroup_fd = -1;
+    int procs_fd = -1;
+    if (!options.cgroup.empty()) {
+        cgroup_fd = open(options.cgroup.c_str(),
+                         O_PATH | O_DIRECTORY | O_CLOEXEC);
+        procs_fd = open((options.cgroup + "/cgroup.procs").c_str(),
+                        O_WRONLY | O_CLOEXEC);
+        if (cgroup_fd == -1 || procs_fd == -1) {
+            int err = errno;
+            close(cgroup_fd);
+            close(procs_fd);
+            errno = err;
+            return -1;
+        }
+    }
+    int status_pipe[2];
+    if (pipe2(status_pipe, O_CLOEXEC) == -1) {
+        int err = errno;
+        close(cgroup_fd);
+        close(procs_fd);
+        errno = err;
+        return -1;
+    }
+
+    // The child's mask is the driver's without SIGCHLD, as for
+    // posix_spawn. Everything is blocked across the clone so that no
+    // signal is handled in the child before its handlers are reset.
+    sigset_t all, old_mask, child_mask;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old_mask);
+    child_mask = old_mask;
+    sigdelset(&child_mask, SIGCHLD);
+
+    bool placed;
+    pid_t pid = clone_into_cgroup(cgroup_fd, &placed);
+    if (pid == 0) {
+        int err = 0;
+        if (!placed && procs_fd != -1 && write(procs_fd, "0", 1) != 1) {
+            err = errno;
+        }
+        if (!err && options.nice &&
+            setpriority(PRIO_PROCESS, 0, options.nice) == -1) {
+            err = errno;
+        }
+        if (!err && options.ioprio &&
+            syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                    options.ioprio) == -1) {
+            err = errno;
+        }
+        if (!err && !options.cpus.empty() &&
+            sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+            err = errno;
+        }
+        if (!err) {
+            reset_signals(child_mask);
+            execve(module.c_str(), argv, environ);
+            err = errno;
+        }
+        if (write(status_pipe[1], &err, sizeof(err)) != sizeof(err)) {
+            // Nothing else can be done; the parent sees a dead module
+        }
+        _exit(127);
+    }
+    int clone_errno = errno;
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    close(status_pipe[1]);
+    close(cgroup_fd);
+    close(procs_fd);
+    if (pid == -1) {
+        close(status_pipe[0]);
+        errno = clone_errno;
+        return -1;
+    }
+
+    int err = 0;
+    ssize_t size;
+    while ((size = read(status_pipe[0], &err, sizeof(err))) == -1 &&
+           errno == EINTR) { }
+    close(status_pipe[0]);
+    if (size == sizeof(err)) {
+        // Reap it here, so that it isn't mistaken for a module death
+        waitpid(pid, NULL, 0);
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+static pid_t spawn_plain(const FilePath &module, MemKey key) {
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr)) {
+        return -1;
+    }
+
+    // Children shouldn't inherit the driver's blocked SIGCHLD or any
+    // signals it ignores.
+    sigset_t mask;
+    pthread_sigmask(SIG_BLOCK, NULL, &mask);
+    sigdelset(&mask, SIGCHLD);
+    sigset_t defaults;
+    sigfillset(&defaults);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF);
+
+    std::string key_arg = std::to_string(key);
+    char *argv[] = {&key_arg[0], NULL};
+
+    pid_t pid;
+    int err = posix_spawn(&pid, module.c_str(), NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+pid_t spawn_module(const FilePath &module, MemKey key) {
+    return spawn_module(module, key, SpawnOptions());
+}
+
+pid_t spawn_module(const FilePath &module, MemKey key,
+                   const SpawnOptions &options) {
+    SupervisorMetrics &metrics = supervisor_metrics();
+    int64_t start_us = metrics_now_us();
+    pid_t pid = options.is_default() ? spawn_plain(module, key) :
+        spawn_cloned(module, key, options);
+    metrics.spawn_us.record(metrics_now_us() - start_us);
+    if (pid == -1) {
+        int err = errno;
+        metrics.spawn_failures.add();
+        fprintf(stderr, "Unable to launch module %s: %s\n",
+                module.c_str(), strerror(err));
+        errno = err;
+        return -1;
+    }
+    metrics.spawns.add();
+    return pid;
+}
+
+std::vector<SpawnResult> spawn_modules(const std::vector<SpawnRequest> &requests,
+                                       unsigned max_threads) {
+    return spawn_modules(requests, std::vector<SpawnOptions>(), max_threads);
+}
+
+std::vector<SpawnResult> spawn_modules(const std::vector<SpawnRequest> &requests,
+                                       const std::vector<SpawnOptions> &options,
+                                       unsigned max_threads) {
+    std::vector<SpawnResult> results(requests.size());
+    const SpawnOptions defaults;
+    if (max_threads == 0) {
+        max_threads = std::thread::hardware_concurrency();
+        if (max_threads == 0 || max_threads > DEFAULT_MAX_SPAWN_THREADS) {
+            max_threads = DEFAULT_MAX_SPAWN_THREADS;
+        }
+    }
+    unsigned n_threads = max_threads;
+    if (n_threads > requests.size()) {
+        n_threads = requests.size();
+    }
+
+    std::atomic<size_t> next(0);
+    auto spawn_some = [&requests, &options, &defaults, &results, &next]() {
+        size_t i;
+        while ((i = next++) < requests.size()) {
+            results[i].pid = spawn_module(
+                requests[i].first, requests[i].second,
+                i < options.size() ? options[i] : defaults);
+            results[i].error = results[i].pid == -1 ? errno : 0;
+        }
+    };
+
+    if (n_threads <= 1) {
+        spawn_some();
+        return results;
+    }
+    std::vector<std::thread> threads;
+    // The calling thread spawns too
+    for (unsigned i = 1; i < n_threads; i++) {
+        threads.push_back(std::thread(spawn_some));
+    }
+    spawn_some();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return results;
+}
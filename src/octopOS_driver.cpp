@@ -16,24 +16,41 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <cerrno>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <pthread.h>
+#include <signal.h>
 #include <dirent.h>
+#include <climits>
+#include <deque>
 #include <list>
+#include <mutex>
 #include <fstream>
 #include <utility>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "../include/Optional.hpp"
 #include "../include/octopOS_driver.hpp"
+#include "../include/config_reloader.hpp"
+#include "../include/event_loop.hpp"
+#include "../include/journal.hpp"
+#include "../include/metrics.hpp"
+#include "../include/metrics_server.hpp"
+#include "../include/module_resources.hpp"
+#include "../include/module_spawner.hpp"
+#include "../include/restart_scheduler.hpp"
+#include "../include/watchdog.hpp"
 
 const char*  CONFIG_PATH = "/etc/octopOS/config.json";
 const char*  UPGRADE_TOPIC = "module_upgrade";
 const char*  DOWNGRADE_TOPIC = "module_downgrade";
-const time_t RUNTIME_CUTOFF_DOWNGRADE_S = 5*60;
-const int    DEATH_COUNT_CUTOFF_DOWNGRADE = 5;
+const double CPU_BURN_CUTOFF_DOWNGRADE = 0.9;
 const bool   LISTEN_FOR_MODULE_UPGRADES = true;
 const int    OCTOPOS_INTERNAL_TENTACLE_INDEX = 0;
+const size_t LISTENER_STACK_SIZE = 256 * 1024;
 
 int memkey_to_tentacle_index(MemKey key) {
     return key - MSGKEY + 1;
@@ -45,7 +62,12 @@ int tentacle_index_to_memkey(int index) {
 CDH::Optional<json> load(FilePath json_file) {
     if (accessible(json_file)) {
         std::ifstream in(json_file);
-        return Just(json::parse(in));
+        try {
+            return Just(json::parse(in));
+        } catch (const std::exception &e) {
+            std::cerr << "Error: Unable to parse " << json_file << ": "
+                      << e.what() << std::endl;
+        }
     }
     return None<json>();
 }
@@ -82,57 +104,227 @@ CDH::Optional< std::list<FilePath> > files_in(FilePath directory) {
     }
 }
 
+bool block_child_signals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    return !pthread_sigmask(SIG_BLOCK, &mask, NULL);
+}
+
+// Modifies MODULES[SLOT]
+static void request_downgrade_of(ModuleSlot slot, ModuleInfo *modules,
+                                 publisher<OctoString> *downgrade_pub) {
+    journal_event(JOURNAL_DOWNGRADE, slot, modules->at(slot).pid);
+    supervisor_metrics().downgrades.add();
+    request_downgrade(modules->path_of(slot), &modules->at(slot),
+                      downgrade_pub);
+}
+
+static void journal_launch(ModuleSlot slot, const Module &module) {
+    if (module.launch_error) {
+        journal_event(JOURNAL_LAUNCH_FAILED, slot, -1, module.launch_error);
+    } else {
+        journal_event(JOURNAL_LAUNCH, slot, module.pid);
+    }
+}
+
+// Modifies MODULE
+static void record_relaunch(Module *module) {
+    SupervisorMetrics &metrics = supervisor_metrics();
+    metrics.restarts.add();
+    if (!module->launch_error && module->died_at_us) {
+        metrics.downtime_us.record(metrics_now_us() - module->died_at_us);
+        module->died_at_us = 0;
+    }
+}
+
+// Modifies MODULE
+static void remove_cgroup_of(Module *module) {
+    if (!module->cgroup.empty()) {
+        remove_module_cgroup(module->cgroup);
+        module->cgroup.clear();
+    }
+}
+
 // launches the given module in a new child process
 pid_t launch(FilePath module, MemKey key) {
-    pid_t pid;
-    pid = fork();
-    switch (pid) {
-    case -1:
-        perror("Fork failed in attempting to launch module.");
-        break;
-    case 0:  // child
-        execl(module.c_str(), std::to_string(key).c_str(), (char*)0);  // NOLINT
-        exit(0);
-    default:  // parent
-        break;
-    }
-    return pid;
+    return spawn_module(module, key);
 }
 
 // Modifies MODULE
 void relaunch(Module *module, FilePath path) {
     module->killed = false;
     module->downgrade_requested = false;
-    module->pid = launch(path, tentacle_index_to_memkey(module->tentacle_id));
+    SpawnOptions options = spawn_options_for(path, module->config.resources);
+    module->cgroup = options.cgroup;
+    module->pid = spawn_module(path,
+                               tentacle_index_to_memkey(module->tentacle_id),
+                               options);
+    module->launch_error = module->pid == -1 ? errno : 0;
     module->launch_time = time(0);
 }
 
+// The tentacle indices handed to listener threads. listen_for_child
+// reads its index through the pointer it is given, so entries are never
+// freed or moved (push_back on a deque doesn't move elements).
+static std::deque<MemKey> listener_keys;
+static std::unordered_set<int> listening_tentacles;
+static std::mutex listener_mutex;
+
 bool launch_octopOS_listener_for_child(int tentacle_index) {
+    std::lock_guard<std::mutex> lock(listener_mutex);
+    if (listening_tentacles.count(tentacle_index)) {
+        // A relaunched module talks over the same tentacle, which is
+        // still being listened on
+        return true;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    size_t stack_size = LISTENER_STACK_SIZE;
+    if (stack_size < (size_t)PTHREAD_STACK_MIN) {
+        stack_size = PTHREAD_STACK_MIN;
+    }
+    pthread_attr_setstacksize(&attr, stack_size);
+
+    listener_keys.push_back(tentacle_index);
     pthread_t thread;
-    // tentacle_ID should be a somewhat persistent pointer, because
-    // pthread_create casts it to a int* and then derefs it to get the
-    // value
-    MemKey *idxptr = NULL;
-    if ((idxptr = (MemKey*)malloc(sizeof(MemKey))) == NULL) { // NOLINT
-      return false;
+    bool ok = !pthread_create(&thread, &attr, octopOS::listen_for_child,
+                              &listener_keys.back());
+    pthread_attr_destroy(&attr);
+    if (ok) {
+        listening_tentacles.insert(tentacle_index);
+        supervisor_metrics().listeners.add();
+    } else {
+        listener_keys.pop_back();
     }
-    *idxptr = tentacle_index;
-    return !pthread_create(&thread, NULL, octopOS::listen_for_child, idxptr);
+    return ok;
 }
 
-LaunchInfo launch_modules_in(FilePath dir, MemKey start_key) {
-    ModuleInfo modules;
+// Modifies MODULES
+MemKey launch_modules(const std::list<FilePath> &paths, MemKey start_key,
+                      const json &config, ModuleInfo *modules) {
     MemKey current_key = start_key;
-    pid_t pid;
-    for (FilePath module : modules_in(dir)) {
-        pid_t pid = launch(module, current_key);
+    std::vector<SpawnRequest> requests;
+    std::vector<ModuleConfig> configs;
+    std::vector<SpawnOptions> options;
+    for (FilePath module : paths) {
+        requests.push_back(std::make_pair(module, current_key++));
+        configs.push_back(module_config_for(config, module));
+        options.push_back(spawn_options_for(module, configs.back().resources));
+    }
+
+    // Modules don't depend on each other to start, so start them all
+    // at once
+    std::vector<SpawnResult> results = spawn_modules(requests, options);
+    time_t now = time(0);
+    for (size_t i = 0; i < requests.size(); i++) {
         // Tentacle IDs for children start at 1 because 0 is for octopOS
-        modules[module] = Module(pid, memkey_to_tentacle_index(current_key),
-                                 time(0));
-        launch_octopOS_listener_for_child(modules[module].tentacle_id);
-        current_key++;
+        ModuleSlot slot = modules->add(
+            requests[i].first,
+            Module(results[i].pid, memkey_to_tentacle_index(requests[i].second),
+                   now));
+        modules->at(slot).launch_error = results[i].error;
+        modules->at(slot).config = configs[i];
+        modules->at(slot).cgroup = options[i].cgroup;
+        journal_launch(slot, modules->at(slot));
+        launch_octopOS_listener_for_child(modules->at(slot).tentacle_id);
     }
-    return std::make_pair(modules, current_key);
+    return current_key;
+}
+
+LaunchInfo launch_modules_in(FilePath dir, MemKey start_key,
+                             const json &config) {
+    ModuleInfo modules;
+    MemKey next_key = launch_modules(modules_in(dir), start_key, config,
+                                     &modules);
+    return std::make_pair(modules, next_key);
+}
+
+ModuleDiff diff_modules(const ModuleInfo &modules,
+                        const std::list<FilePath> &enabled,
+                        const json &config) {
+    ModuleDiff diff;
+    std::unordered_set<FilePath> enabled_set(enabled.begin(), enabled.end());
+    for (const FilePath &path : enabled) {
+        CDH::Optional<ModuleSlot> slot = modules.slot_of(path);
+        if (slot.isEmpty() || modules.at(slot.get()).retired) {
+            diff.added.push_back(path);
+        } else if (modules.at(slot.get()).config !=
+                   module_config_for(config, path)) {
+            diff.reconfigured.push_back(path);
+        }
+    }
+    for (ModuleSlot slot = 0; slot < modules.size(); slot++) {
+        if (!modules.at(slot).retired &&
+            !enabled_set.count(modules.path_of(slot))) {
+            diff.removed.push_back(modules.path_of(slot));
+        }
+    }
+    return diff;
+}
+
+// Modifies MODULES
+MemKey apply_module_diff(const ModuleDiff &diff, const json &config,
+                         MemKey next_key, ModuleInfo *modules,
+                         publisher<OctoString> *downgrade_pub,
+                         RestartScheduler *scheduler) {
+    for (const FilePath &path : diff.removed) {
+        ModuleSlot slot = modules->intern(path);
+        Module &module = modules->at(slot);
+        bool restart_pending = scheduler && scheduler->pending(slot);
+        module.retired = true;
+        journal_event(JOURNAL_RETIRE, slot, module.pid);
+        if (restart_pending) {
+            scheduler->cancel(slot);
+        }
+        if (module.downgrade_requested || restart_pending ||
+            kill_module(path, modules) == -1) {
+            // Nothing is running, so there is no death to wait for
+            module.pid = -1;
+            modules->reindex(slot);
+            remove_cgroup_of(&module);
+        }
+    }
+
+    for (const FilePath &path : diff.reconfigured) {
+        Module &module = (*modules)[path];
+        module.config = module_config_for(config, path);
+        if (!module.cgroup.empty()) {
+            // Cgroup limits can change under a running module; its
+            // other settings apply from its next launch
+            prepare_module_cgroup(module.cgroup, module.config.resources);
+        }
+    }
+
+    std::list<FilePath> fresh;
+    for (const FilePath &path : diff.added) {
+        CDH::Optional<ModuleSlot> found = modules->slot_of(path);
+        if (found.isEmpty()) {
+            fresh.push_back(path);
+            continue;
+        }
+        // Enabled again: reuse its slot and tentacle
+        ModuleSlot slot = found.get();
+        Module &module = modules->at(slot);
+        module.retired = false;
+        module.config = module_config_for(config, path);
+        if (module.pid <= 0) {
+            relaunch_module(slot, modules, downgrade_pub);
+        }
+        // Otherwise it is still dying from being removed, and will be
+        // relaunched when it does since it was killed intentionally
+    }
+
+    ModuleSlot first_fresh = modules->size();
+    next_key = launch_modules(fresh, next_key, config, modules);
+    for (ModuleSlot slot = first_fresh; slot < modules->size(); slot++) {
+        if (modules->at(slot).launch_error) {
+            request_downgrade_of(slot, modules, downgrade_pub);
+        }
+    }
+    return next_key;
 }
 
 bool launch_octopOS_listeners() {
@@ -162,82 +354,363 @@ std::list<FilePath> modules_in(FilePath dir) {
 
 // Modifies MODULES[PATH]
 int kill_module(std::string path, ModuleInfo *modules) {
-    Module &module = (*modules)[path];
+    ModuleSlot slot = modules->intern(path);
+    Module &module = modules->at(slot);
     module.killed = true;
     // Intentional deaths should reset early death counter
     module.early_death_count = 0;
+    if (module.pid <= 0) {
+        // Never started; kill(-1, ...) would signal every process we
+        // are allowed to
+        errno = ESRCH;
+        return -1;
+    }
+    journal_event(JOURNAL_KILL, slot, module.pid, SIGTERM);
     return kill(module.pid, SIGTERM);
 }
 
+DeathCause death_cause(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status) == 0 ? DEATH_CLEAN_EXIT : DEATH_ERROR_EXIT;
+    }
+    switch (WTERMSIG(status)) {
+    case SIGSEGV:
+    case SIGBUS:
+    case SIGILL:
+    case SIGFPE:
+    case SIGABRT:
+    case SIGSYS:
+        return DEATH_CRASH;
+    case SIGKILL:
+        return DEATH_KILLED;
+    default:
+        return DEATH_TERMINATED;
+    }
+}
+
+long timeval_to_us(const struct timeval &tv) {
+    return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+// Modifies MODULE
+void record_death(Module *module, int status, const struct rusage &usage) {
+    module->death_count++;
+    module->last_status = status;
+    module->last_cpu_time_us =
+        timeval_to_us(usage.ru_utime) + timeval_to_us(usage.ru_stime);
+    module->cpu_time_us += module->last_cpu_time_us;
+    if (usage.ru_maxrss > module->max_rss_kb) {
+        module->max_rss_kb = usage.ru_maxrss;
+    }
+    if (WIFSIGNALED(status)) {
+        module->signal_history[module->signal_death_count %
+                               SIGNAL_HISTORY_LENGTH] = WTERMSIG(status);
+        module->signal_death_count++;
+    }
+}
+
 // Modifies MODULE to record premature death if necessary
 bool module_needs_downgrade(Module *module) {
-    int died_quickly =
-        (time(0) - (module -> launch_time)) < RUNTIME_CUTOFF_DOWNGRADE_S;
-    if (died_quickly) {
+    const RestartPolicy &policy = module->config.restart;
+    time_t runtime = time(0) - (module -> launch_time);
+    bool died_quickly = runtime < policy.runtime_cutoff_s;
+    DeathCause cause = module->death_count > 0 ?
+        death_cause(module->last_status) : DEATH_CLEAN_EXIT;
+    bool crashed = cause == DEATH_CRASH || cause == DEATH_KILLED;
+    bool burned_cpu = cause != DEATH_CLEAN_EXIT && runtime > 0 &&
+        module->last_cpu_time_us >=
+        CPU_BURN_CUTOFF_DOWNGRADE * runtime * 1000000L;
+    bool suspicious = died_quickly || crashed || burned_cpu;
+    if (suspicious) {
         module -> early_death_count += 1;
     } else {
         // "Normal" deaths should reset early death counter
         module -> early_death_count = 0;
     }
     int died_too_many_times =
-        (module -> early_death_count) > DEATH_COUNT_CUTOFF_DOWNGRADE;
+        (module -> early_death_count) > policy.death_count_cutoff;
 
-    return died_quickly && died_too_many_times;
+    return suspicious && died_too_many_times;
 }
 
 void downgrade(FilePath module_name, publisher<OctoString> *downgrade_pub) {
     downgrade_pub->publish(OctoString(module_name));
 }
 
+// Modifies MODULE
+void request_downgrade(FilePath path, Module *module,
+                       publisher<OctoString> *downgrade_pub) {
+    module->downgrade_requested = true;
+    // Reset death count to give downgraded module a chance
+    module->early_death_count = 0;
+    downgrade(path, downgrade_pub);
+}
+
+// Modifies MODULES[SLOT]
+void relaunch_module(ModuleSlot slot, ModuleInfo *modules,
+                     publisher<OctoString> *downgrade_pub) {
+    Module &module = modules->at(slot);
+    relaunch(&module, modules->path_of(slot));
+    modules->reindex(slot);
+    journal_launch(slot, module);
+    record_relaunch(&module);
+    if (module.launch_error) {
+        // The executable can't be started at all, so retrying it
+        // can only fail again
+        request_downgrade_of(slot, modules, downgrade_pub);
+    }
+}
+
 // Modifies MODULES[PATH]
 void reboot_module(std::string path, ModuleInfo *modules,
-                   publisher<OctoString> *downgrade_pub) {
-    Module &module = (*modules)[path];
+                   publisher<OctoString> *downgrade_pub,
+                   RestartScheduler *scheduler) {
+    ModuleSlot slot = modules->intern(path);
+    Module &module = modules->at(slot);
+    if (module.retired) {
+        // Removed from the enabled modules, so let it stay dead
+        journal_event(JOURNAL_RETIRE, slot, module.pid);
+        module.pid = -1;
+        module.died_at_us = 0;
+        remove_cgroup_of(&module);
+        modules->reindex(slot);
+        return;
+    }
     if (module.killed || !module_needs_downgrade(&module)) {
         // Death was intentional or unsuspicious
-        relaunch(&module, path);
+        int64_t delay = 0;
+        if (scheduler && !module.killed) {
+            delay = scheduler->delay_for(module);
+        }
+        if (delay > 0) {
+            // Crash looping: back off instead of restarting right away
+            journal_event(JOURNAL_BACKOFF, slot, module.pid, delay);
+            supervisor_metrics().backoffs.add();
+            scheduler->schedule(slot, delay, [slot, modules, downgrade_pub]() {
+                relaunch_module(slot, modules, downgrade_pub);
+            });
+        } else {
+            relaunch_module(slot, modules, downgrade_pub);
+        }
     } else {
         // Death warrants downgrade
-        module.downgrade_requested = true;
-        // Reset death count to give downgraded module a chance
-        module.early_death_count = 0;
-        downgrade(path, downgrade_pub);
+        request_downgrade_of(slot, modules, downgrade_pub);
+    }
+}
+
+// Modifies MODULES
+void downgrade_unstartable_modules(ModuleInfo *modules,
+                                   publisher<OctoString> *downgrade_pub) {
+    for (ModuleSlot slot = 0; slot < modules->size(); slot++) {
+        Module &module = modules->at(slot);
+        if (module.launch_error && !module.downgrade_requested &&
+            !module.retired) {
+            request_downgrade_of(slot, modules, downgrade_pub);
+        }
     }
 }
 
 CDH::Optional<std::string> find_module_with(pid_t pid, const ModuleInfo &modules) {
-    auto moduleIt =
-        std::find_if(modules.begin(), modules.end(),
-                     [&pid](const std::pair<std::string, Module> el) {
-                         return el.second.pid == pid;
-                     });
-    if (moduleIt == modules.end()) {
+    CDH::Optional<ModuleSlot> slot = modules.slot_with(pid);
+    if (slot.isEmpty()) {
         return None<std::string>();
     } else {
-        return Just(moduleIt -> first);
+        return Just(modules.path_of(slot.get()));
+    }
+}
+
+// Modifies MODULES
+void relaunch_modules(const std::vector<ModuleSlot> &slots,
+                      ModuleInfo *modules,
+                      publisher<OctoString> *downgrade_pub) {
+    std::vector<SpawnRequest> requests;
+    std::vector<SpawnOptions> options;
+    for (ModuleSlot slot : slots) {
+        requests.push_back(std::make_pair(
+            modules->path_of(slot),
+            tentacle_index_to_memkey(modules->at(slot).tentacle_id)));
+        options.push_back(spawn_options_for(
+            modules->path_of(slot), modules->at(slot).config.resources));
+    }
+    std::vector<SpawnResult> results = spawn_modules(requests, options);
+    time_t now = time(0);
+    for (size_t i = 0; i < slots.size(); i++) {
+        Module &module = modules->at(slots[i]);
+        module.killed = false;
+        module.downgrade_requested = false;
+        module.pid = results[i].pid;
+        module.launch_error = results[i].error;
+        module.launch_time = now;
+        module.cgroup = options[i].cgroup;
+        modules->reindex(slots[i]);
+        journal_launch(slots[i], module);
+        record_relaunch(&module);
+        if (module.launch_error && downgrade_pub) {
+            request_downgrade_of(slots[i], modules, downgrade_pub);
+        }
     }
 }
 
+// Modifies MODULES
+void handle_upgrade_requests(const std::vector<std::string> &module_paths,
+                             ModuleInfo *modules,
+                             publisher<OctoString> *downgrade_pub,
+                             RestartScheduler *scheduler) {
+    int64_t start_us = metrics_now_us();
+    std::unordered_set<std::string> seen;
+    std::vector<ModuleSlot> to_relaunch;
+    for (const std::string &module_path : module_paths) {
+        if (!seen.insert(module_path).second) {
+            continue;
+        }
+        ModuleSlot slot = modules->intern(module_path);
+        Module &module = modules->at(slot);
+        if (module.retired) {
+            journal_event(JOURNAL_UPGRADE_IGNORED, slot, module.pid);
+            continue;
+        }
+        journal_event(JOURNAL_UPGRADE, slot, module.pid);
+        supervisor_metrics().upgrades.add();
+        bool restart_pending = scheduler && scheduler->pending(slot);
+        if (module.downgrade_requested || module.pid <= 0 || restart_pending) {
+            // Nothing running to replace, so just start the new version
+            if (restart_pending) {
+                scheduler->cancel(slot);
+            }
+            to_relaunch.push_back(slot);
+        } else if (!module.killed) {
+            kill_module(module_path, modules);
+        }
+        // Otherwise it is already dying from an earlier request, and will
+        // be relaunched from the new executable once it has
+    }
+    relaunch_modules(to_relaunch, modules, downgrade_pub);
+    supervisor_metrics().upgrade_us.record(metrics_now_us() - start_us);
+}
+
+// Modifies MODULES[MODULE_PATH]
+void handle_upgrade_request(std::string module_path, ModuleInfo *modules,
+                            RestartScheduler *scheduler) {
+    handle_upgrade_requests(std::vector<std::string>(1, module_path), modules,
+                            NULL, scheduler);
+}
+
+/** Upgrade requests received but not yet handled by the loop. */
+struct UpgradeQueue {
+    std::mutex mutex;
+    std::vector<std::string> module_paths;
+    /** When the oldest queued request was received. */
+    int64_t oldest_us;
+};
+
+struct UpgradeForwarderInfo {
+    subscriber<OctoString> *upgrade_sub;
+    EventLoop *loop;
+    ModuleInfo *modules;
+    publisher<OctoString> *downgrade_pub;
+    RestartScheduler *scheduler;
+    UpgradeQueue *queue;
+};
+
+// OctopOS subscribers don't expose a descriptor we can wait on, but
+// get_data blocks until a message arrives. This thread queues each
+// message for the babysitting loop so that all module state is still
+// only touched from that one thread. The loop is only woken when the
+// queue was empty; requests arriving before it runs join the same
+// batch, so a burst is handled in one pass.
+void* forward_upgrade_requests(void *arg) {
+    UpgradeForwarderInfo info = *(UpgradeForwarderInfo*)arg;  // NOLINT
+    while (1) {
+        std::vector<std::string> received;
+        received.push_back(info.upgrade_sub->get_data());
+        while (info.upgrade_sub->data_available()) {
+            received.push_back(info.upgrade_sub->get_data());
+        }
+        supervisor_metrics().upgrade_requests.add(received.size());
+
+        bool was_empty;
+        {
+            std::lock_guard<std::mutex> lock(info.queue->mutex);
+            was_empty = info.queue->module_paths.empty();
+            if (was_empty) {
+                info.queue->oldest_us = metrics_now_us();
+            }
+            info.queue->module_paths.insert(info.queue->module_paths.end(),
+                                            received.begin(), received.end());
+        }
+        if (was_empty) {
+            info.loop->post([info]() {
+                std::vector<std::string> batch;
+                int64_t oldest_us;
+                {
+                    std::lock_guard<std::mutex> lock(info.queue->mutex);
+                    batch.swap(info.queue->module_paths);
+                    oldest_us = info.queue->oldest_us;
+                }
+                supervisor_metrics().upgrade_wait_us.record(
+                    metrics_now_us() - oldest_us);
+                handle_upgrade_requests(batch, info.modules,
+                                        info.downgrade_pub, info.scheduler);
+            });
+        }
+    }
+    return NULL;
+}
+
 // Watch over children, rebooting and upgrading modules
 void babysit_forever(ModuleInfo *modules,
                      publisher<OctoString> *downgrade_pub,
-                     subscriber<OctoString> *upgrade_sub) {
-    while (1) {
-        // reboot any dead modules
-        reboot_dead_modules(modules, downgrade_pub);
-
-        // check for upgrade data
-        if (upgrade_sub->data_available()) {
-            std::string module_path = upgrade_sub->get_data();
-            Module &module = (*modules)[module_path];
-            if (module.downgrade_requested) {
-                relaunch(&module, module_path);
-            } else {
-                kill_module(module_path, modules);
-            }
+                     subscriber<OctoString> *upgrade_sub,
+                     const json &config, MemKey next_key) {
+    block_child_signals();
+    EventLoop loop;
+    RestartScheduler scheduler(&loop);
+    loop.watch_signal(SIGCHLD, [modules, downgrade_pub, &scheduler]() {
+        reboot_dead_modules(modules, downgrade_pub, &scheduler);
+    });
+    // Catch any deaths from before the signal was being watched
+    reboot_dead_modules(modules, downgrade_pub, &scheduler);
+    // Modules that never started won't ever die to be noticed
+    downgrade_unstartable_modules(modules, downgrade_pub);
+
+    Watchdog watchdog(&loop, modules);
+    if (!watchdog.start()) {
+        std::cerr << "Error: Unable to create the heartbeat table. Hung "
+                  << "modules won't be detected." << std::endl;
+    }
+
+    MetricsServer metrics_server(&loop, modules);
+    FilePath metrics_socket = config.value("metrics_socket",
+                                           METRICS_SOCKET_PATH);
+    if (!metrics_server.start(metrics_socket)) {
+        std::cerr << "Error: Unable to serve metrics on " << metrics_socket
+                  << "." << std::endl;
+    }
+
+    UpgradeQueue upgrade_queue;
+    upgrade_queue.oldest_us = 0;
+    UpgradeForwarderInfo forwarder_info = {upgrade_sub, &loop, modules,
+                                           downgrade_pub, &scheduler,
+                                           &upgrade_queue};
+    if (LISTEN_FOR_MODULE_UPGRADES) {
+        pthread_t forwarder_thread;
+        if (pthread_create(&forwarder_thread, NULL, forward_upgrade_requests,
+                           &forwarder_info)) {
+            std::cerr << "Error: Unable to spawn upgrade listener thread. "
+                      << "Module upgrades will be ignored." << std::endl;
+        } else {
+            pthread_detach(forwarder_thread);
         }
-        usleep(10000);
     }
+
+    ConfigReloader reloader(&loop, CONFIG_PATH, config, next_key, modules,
+                            downgrade_pub, &scheduler, &watchdog);
+    if (config["modules_enabled"].is_string() && !reloader.start()) {
+        std::cerr << "Error: Unable to watch " << CONFIG_PATH << " for "
+                  << "changes. Config changes need a restart." << std::endl;
+    }
+
+    loop.run();
 }
 
 octopOS& launch_octopOS() {
@@ -253,17 +726,31 @@ octopOS& launch_octopOS() {
 }
 
 void reboot_dead_modules(ModuleInfo *modules,
-                         publisher<OctoString> *downgrade_pub) {
+                         publisher<OctoString> *downgrade_pub,
+                         RestartScheduler *scheduler) {
+    SupervisorMetrics &metrics = supervisor_metrics();
+    int64_t start_us = metrics_now_us();
+    bool reaped = false;
     pid_t pid;
-    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
-        CDH::Optional<std::string> found = find_module_with(pid, *modules);
+    int status;
+    struct rusage usage;
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        reaped = true;
+        CDH::Optional<ModuleSlot> found = modules->slot_with(pid);
         if (found.isEmpty()) {
-            std::cerr << "Notification of unregistered module death "
-                      << "with pid " << pid << ". "
-                      << "Something has probably gone horribly wrong."
-                      << std::endl;
+            // Something has probably gone horribly wrong
+            journal_event(JOURNAL_UNKNOWN_DEATH, JOURNAL_NO_SLOT, pid, status);
+            metrics.unknown_deaths.add();
         } else {
-            reboot_module(found.get(), modules, downgrade_pub);
+            journal_event(JOURNAL_DEATH, found.get(), pid, status);
+            metrics.deaths.add();
+            modules->at(found.get()).died_at_us = start_us;
+            record_death(&modules->at(found.get()), status, usage);
+            reboot_module(modules->path_of(found.get()), modules,
+                          downgrade_pub, scheduler);
         }
     }
+    if (reaped) {
+        metrics.reap_us.record(metrics_now_us() - start_us);
+    }
 }
@@ -0,0 +1,42 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Backoff scheduling for restarts of crash-looping modules.
+ */
+
+#include <ctime>
+#include <unistd.h>
+
+#include "../include/restart_scheduler.hpp"
+
+RestartScheduler::RestartScheduler(EventLoop *_loop):
+    loop(_loop), random(time(0) ^ getpid()) { }
+
+int64_t RestartScheduler::delay_for(const Module &module) {
+    double random_unit = (random() - random.min()) /
+        ((double)random.max() - random.min() + 1);  // NOLINT
+    return restart_delay_ms(module.config.restart, module.early_death_count,
+                            random_unit);
+}
+
+void RestartScheduler::schedule(ModuleSlot slot, int64_t delay_ms,
+                                EventLoop::Callback restart) {
+    cancel(slot);
+    timers[slot] = loop->schedule(delay_ms, [this, slot, restart]() {
+        timers.erase(slot);
+        restart();
+    });
+}
+
+void RestartScheduler::cancel(ModuleSlot slot) {
+    auto found = timers.find(slot);
+    if (found != timers.end()) {
+        loop->cancel(found->second);
+        timers.erase(found);
+    }
+}
@@ -0,0 +1,221 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief A hierarchical timer wheel for the driver's timers.
+ */
+
+#include <utility>
+#include <vector>
+
+#include "../include/timer_wheel.hpp"
+
+TimerWheel::TimerWheel(int64_t now_ms): now_tick(now_ms), pending(0) {
+    for (int level = 0; level < LEVELS; level++) {
+        level_counts[level] = 0;
+    }
+    for (int i = 0; i < LEVELS * SLOTS; i++) {
+        heads[i] = NIL;
+    }
+}
+
+TimerId TimerWheel::schedule(int64_t deadline_ms, Callback callback) {
+    uint32_t index;
+    if (!free_entries.empty()) {
+        index = free_entries.back();
+        free_entries.pop_back();
+    } else {
+        index = entries.size();
+        entries.push_back(Entry());
+        entries[index].generation = 0;
+        entries[index].bucket = NIL;
+    }
+    Entry &entry = entries[index];
+    entry.deadline = deadline_ms > now_tick ? deadline_ms : now_tick + 1;
+    entry.callback = callback;
+    place(index);
+    pending++;
+    return ((TimerId)entry.generation << 32) | index;  // NOLINT
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    uint32_t index = id & 0xFFFFFFFF;
+    uint32_t generation = id >> 32;
+    if (index >= entries.size() || entries[index].generation != generation ||
+        entries[index].bucket == NIL) {
+        return false;
+    }
+    unlink(index);
+    release(index);
+    pending--;
+    return true;
+}
+
+// Links the entry into the slot for its deadline: the lowest level
+// whose span covers the time left until the deadline.
+void TimerWheel::place(uint32_t index) {
+    Entry &entry = entries[index];
+    int64_t delta = entry.deadline - now_tick;
+    int64_t when = entry.deadline;
+    int level = 0;
+    if (delta <= 0) {
+        // Due now; this only happens while cascading
+        when = now_tick;
+    } else {
+        while (level < LEVELS - 1 &&
+               delta >= (int64_t)1 << (SLOT_BITS * (level + 1))) {  // NOLINT
+            level++;
+        }
+        int64_t span = (int64_t)1 << (SLOT_BITS * LEVELS);  // NOLINT
+        if (delta >= span) {
+            // Too far away for the wheel; park it as far out as possible
+            // and re-file it when that slot cascades
+            when = now_tick + span - 1;
+        }
+    }
+    uint32_t bucket = level * SLOTS +
+        ((when >> (SLOT_BITS * level)) & (SLOTS - 1));
+    entry.bucket = bucket;
+    entry.prev = NIL;
+    entry.next = heads[bucket];
+    if (heads[bucket] != NIL) {
+        entries[heads[bucket]].prev = index;
+    }
+    heads[bucket] = index;
+    level_counts[level]++;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Entry &entry = entries[index];
+    if (entry.prev != NIL) {
+        entries[entry.prev].next = entry.next;
+    } else {
+        heads[entry.bucket] = entry.next;
+    }
+    if (entry.next != NIL) {
+        entries[entry.next].prev = entry.prev;
+    }
+    level_counts[entry.bucket / SLOTS]--;
+    entry.bucket = NIL;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Entry &entry = entries[index];
+    entry.callback = Callback();
+    entry.generation++;
+    entry.bucket = NIL;
+    free_entries.push_back(index);
+}
+
+// Moves every entry in the current slot of LEVEL down to lower levels
+void TimerWheel::cascade(int level) {
+    uint32_t bucket = level * SLOTS +
+        ((now_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    uint32_t index = heads[bucket];
+    heads[bucket] = NIL;
+    while (index != NIL) {
+        uint32_t next = entries[index].next;
+        level_counts[level]--;
+        place(index);
+        index = next;
+    }
+}
+
+size_t TimerWheel::expire_current_slot() {
+    uint32_t bucket = now_tick & (SLOTS - 1);
+    std::vector<Callback> due;
+    uint32_t index = heads[bucket];
+    while (index != NIL) {
+        uint32_t next = entries[index].next;
+        if (entries[index].deadline <= now_tick) {
+            due.push_back(std::move(entries[index].callback));
+            unlink(index);
+            release(index);
+            pending--;
+        }
+        index = next;
+    }
+    // Run callbacks only once the wheel is consistent, since they may
+    // schedule or cancel timers
+    for (Callback &callback : due) {
+        callback();
+    }
+    return due.size();
+}
+
+size_t TimerWheel::advance(int64_t now_ms) {
+    size_t fired = 0;
+    while (now_tick < now_ms) {
+        if (pending == 0) {
+            now_tick = now_ms;
+            break;
+        }
+        int lowest = 0;
+        while (level_counts[lowest] == 0) {
+            lowest++;
+        }
+        if (lowest > 0) {
+            // Nothing can happen before the next boundary of the lowest
+            // occupied level, so skip straight to it
+            int shift = SLOT_BITS * lowest;
+            int64_t boundary = ((now_tick >> shift) + 1) << shift;
+            if (boundary > now_ms) {
+                now_tick = now_ms;
+                break;
+            }
+            now_tick = boundary - 1;
+        }
+
+        now_tick++;
+        for (int level = 1; level < LEVELS; level++) {
+            int64_t mask = ((int64_t)1 << (SLOT_BITS * level)) - 1;  // NOLINT
+            if (now_tick & mask) {
+                break;
+            }
+            cascade(level);
+        }
+        fired += expire_current_slot();
+    }
+    return fired;
+}
+
+CDH::Optional<int64_t> TimerWheel::next_deadline() const {
+    if (pending == 0) {
+        return None<int64_t>();
+    }
+    bool found = false;
+    int64_t earliest = 0;
+    if (level_counts[0]) {
+        for (int64_t tick = now_tick + 1; tick < now_tick + SLOTS; tick++) {
+            if (heads[tick & (SLOTS - 1)] != NIL) {
+                found = true;
+                earliest = tick;
+                break;
+            }
+        }
+    }
+    // Higher levels wake us up when their slot cascades, which is never
+    // later than any deadline in the slot
+    for (int level = 1; level < LEVELS; level++) {
+        if (!level_counts[level]) {
+            continue;
+        }
+        int shift = SLOT_BITS * level;
+        int64_t block = now_tick >> shift;
+        for (int64_t offset = 1; offset <= SLOTS; offset++) {
+            if (heads[level * SLOTS + ((block + offset) & (SLOTS - 1))] != NIL) {
+                int64_t cascade_tick = (block + offset) << shift;
+                if (!found || cascade_tick < earliest) {
+                    found = true;
+                    earliest = cascade_tick;
+                }
+                break;
+            }
+        }
+    }
+    return found ? Just(earliest) : None<int64_t>();
+}
@@ -0,0 +1,144 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Detects and kills hung modules from their heartbeats.
+ */
+
+#include <signal.h>
+#include <iostream>
+
+#include "../include/journal.hpp"
+#include "../include/metrics.hpp"
+#include "../include/watchdog.hpp"
+
+const uint32_t HEARTBEAT_TABLE_SIZE = 4096;
+const int64_t WATCHDOG_SLACK_MS = 50;
+
+Watchdog::Watchdog(EventLoop *_loop, ModuleInfo *_modules):
+    loop(_loop), modules(_modules), watched(0), hangs(0) { }
+
+Watchdog::~Watchdog() {
+    for (ModuleSlot slot = 0; slot < watches.size(); slot++) {
+        disarm(slot);
+    }
+    if (table.is_open()) {
+        table.destroy();
+    }
+}
+
+bool Watchdog::start() {
+    if (!table.create(HEARTBEAT_TABLE_SIZE)) {
+        return false;
+    }
+    sync();
+    return true;
+}
+
+int64_t Watchdog::timeout_of(ModuleSlot slot) const {
+    const Module &module = modules->at(slot);
+    return module.retired ? 0 : module.config.watchdog.timeout_ms;
+}
+
+// Modifies the heartbeat table's entries
+void Watchdog::sync() {
+    if (!table.is_open()) {
+        return;
+    }
+    Watch idle = {false, 0, -1, 0};
+    watches.resize(modules->size(), idle);
+    for (ModuleSlot slot = 0; slot < modules->size(); slot++) {
+        int64_t timeout = timeout_of(slot);
+        if (slot >= table.capacity()) {
+            if (timeout > 0 && !watches[slot].armed) {
+                std::cerr << "Error: No heartbeat entry for module "
+                          << modules->path_of(slot) << ". It won't be "
+                          << "watched for hangs." << std::endl;
+            }
+            continue;
+        }
+        HeartbeatEntry &entry = table.entry(slot);
+        entry.timeout_ms.store(timeout);
+        entry.key.store(
+            tentacle_index_to_memkey(modules->at(slot).tentacle_id) + 1,
+            std::memory_order_release);
+        if (timeout > 0 && !watches[slot].armed) {
+            // Treated as just launched, since it may not have found its
+            // entry yet
+            watches[slot].pid = -1;
+            arm(slot, 0);
+        } else if (timeout <= 0) {
+            disarm(slot);
+        }
+    }
+}
+
+void Watchdog::arm(ModuleSlot slot, int64_t delay_ms) {
+    int64_t now = EventLoop::now_ms();
+    int64_t deadline = (now + delay_ms + WATCHDOG_SLACK_MS - 1) /
+        WATCHDOG_SLACK_MS * WATCHDOG_SLACK_MS;
+    Watch &watch = watches[slot];
+    if (!watch.armed) {
+        watched++;
+    }
+    watch.armed = true;
+    watch.timer = loop->schedule(deadline - now, [this, slot]() {
+        check(slot);
+    });
+}
+
+void Watchdog::disarm(ModuleSlot slot) {
+    Watch &watch = watches[slot];
+    if (watch.armed) {
+        loop->cancel(watch.timer);
+        watch.armed = false;
+        watched--;
+    }
+}
+
+// Modifies MODULES[SLOT] if it is hung
+void Watchdog::check(ModuleSlot slot) {
+    Watch &watch = watches[slot];
+    watch.armed = false;
+    watched--;
+    Module &module = modules->at(slot);
+    int64_t timeout = timeout_of(slot);
+    HeartbeatEntry &entry = table.entry(slot);
+    entry.timeout_ms.store(timeout);
+    if (timeout <= 0) {
+        return;
+    }
+
+    uint64_t beats = entry.beats.load(std::memory_order_relaxed);
+    if (module.pid <= 0 || module.killed || module.downgrade_requested) {
+        // Not running, or on its way out anyway
+        watch.pid = -1;
+        arm(slot, timeout);
+        return;
+    }
+    if (module.pid != watch.pid) {
+        // Newly launched; give it time to start beating
+        watch.pid = module.pid;
+        watch.beats = beats;
+        arm(slot, module.config.watchdog.startup_grace_ms);
+        return;
+    }
+    if (beats != watch.beats) {
+        watch.beats = beats;
+        arm(slot, timeout);
+        return;
+    }
+
+    journal_event(JOURNAL_HANG, slot, module.pid, timeout);
+    module.hang_count++;
+    hangs++;
+    supervisor_metrics().hangs.add();
+    // Not marked as killed, so that the death counts as suspicious
+    kill(module.pid, SIGKILL);
+    watch.pid = -1;
+    arm(slot, timeout);
+}
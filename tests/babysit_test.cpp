@@ -36,6 +36,9 @@ void* run_babysit_forever(void *modules) {
 }
 
 BOOST_AUTO_TEST_CASE(babysit_forever_test) {
+    // Child deaths are only seen by babysit_forever if every thread
+    // blocks SIGCHLD
+    BOOST_REQUIRE(block_child_signals());
     // ----- HERE BE DRAGONS! DO NOT TOUCH! -----
     BOOST_REQUIRE_NO_THROW(octopOS::getInstance());
     MemKey current_key = MSGKEY;
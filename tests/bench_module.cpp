@@ -0,0 +1,28 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief A stand-in module for benchmarks. Unlike test_module it
+ * starts in about a millisecond and uses next to no CPU, so that
+ * benchmarks measure the driver rather than the module. It beats its
+ * heartbeat as often as a watched module must.
+ */
+
+#include <unistd.h>
+#include <cstdlib>
+
+#include "../include/heartbeat.hpp"
+
+int main(int argc, char *argv[]) {
+    Heartbeat heartbeat(argc > 0 ? strtol(argv[0], NULL, 10) : 0);
+    // Runs until signalled; SIGTERM's default action ends it
+    while (1) {
+        heartbeat.beat();
+        int64_t timeout_ms = heartbeat.timeout_ms();
+        usleep(timeout_ms > 0 ? timeout_ms / 2 * 1000 : 1000 * 1000);
+    }
+}
@@ -0,0 +1,120 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for reloading the config and enabled modules.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE config_reloader
+// Child deaths are not an error
+#define BOOST_TEST_IGNORE_NON_ZERO_CHILD_CODE
+#define BOOST_TEST_IGNORE_SIGCHLD
+#include <boost/test/unit_test.hpp>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include "../include/config_reloader.hpp"
+#include "../include/octopos.h"
+#include "../include/publisher.h"
+
+static void write_file(const std::string &path, const std::string &text) {
+    std::ofstream out(path);
+    out << text;
+}
+
+static void write_module(const std::string &path) {
+    write_file(path, "#!/bin/sh\nexec sleep 60\n");
+    chmod(path.c_str(), 0755);
+}
+
+// Runs LOOP until DONE or a few seconds pass
+static bool run_until(EventLoop *loop, std::function<bool()> done) {
+    for (int i = 0; i < 100 && !done(); i++) {
+        loop->run_once(50);
+    }
+    return done();
+}
+
+BOOST_AUTO_TEST_CASE(reload_test) {
+    BOOST_REQUIRE_NO_THROW(octopOS::getInstance());
+    char dir_template[] = "/tmp/octopos_reload.XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    std::string modules_dir = dir + "/modules";
+    std::string config_path = dir + "/config.json";
+    BOOST_REQUIRE(mkdir(modules_dir.c_str(), 0755) == 0);
+    write_module(modules_dir + "/a");
+    std::string enabled = "\"modules_enabled\": \"" + modules_dir + "\"";
+    write_file(config_path, "{" + enabled + "}");
+
+    json config = load(config_path).get();
+    LaunchInfo info = launch_modules_in(modules_dir, MSGKEY, config);
+    ModuleInfo modules = info.first;
+    MemKey next_key = info.second;
+    publisher<OctoString> downgrade_pub(DOWNGRADE_TOPIC, next_key++);
+    BOOST_REQUIRE(modules.size() == 1);
+    pid_t a_pid = modules[modules_dir + "/a"].pid;
+    BOOST_REQUIRE(a_pid > 1);
+
+    EventLoop loop;
+    ConfigReloader reloader(&loop, config_path, config, next_key, &modules,
+                            &downgrade_pub);
+    BOOST_REQUIRE(reloader.start());
+
+    // Adding a module launches just that module
+    write_module(modules_dir + "/b");
+    BOOST_REQUIRE(run_until(&loop, [&]() { return modules.size() == 2; }));
+    Module &b = modules[modules_dir + "/b"];
+    BOOST_REQUIRE(b.pid > 1);
+    BOOST_REQUIRE(b.tentacle_id == memkey_to_tentacle_index(next_key));
+    BOOST_REQUIRE(reloader.next_memkey() == next_key + 1);
+    BOOST_REQUIRE(modules[modules_dir + "/a"].pid == a_pid);
+
+    // Removing a module kills just that module, and it stays dead
+    unlink((modules_dir + "/a").c_str());
+    BOOST_REQUIRE(run_until(&loop, [&]() {
+        return modules[modules_dir + "/a"].retired;
+    }));
+    BOOST_REQUIRE(modules[modules_dir + "/a"].killed);
+    BOOST_REQUIRE(run_until(&loop, [&]() {
+        reboot_dead_modules(&modules, &downgrade_pub);
+        return modules[modules_dir + "/a"].pid == -1;
+    }));
+    BOOST_REQUIRE(kill(a_pid, 0) == -1);
+    pid_t b_pid = modules[modules_dir + "/b"].pid;
+
+    // Changing a module's settings reconfigures it without a restart
+    write_file(config_path, "{" + enabled + ", \"modules\": {\"b\": "
+               "{\"restart\": {\"death_count_cutoff\": 1}}}}");
+    BOOST_REQUIRE(run_until(&loop, [&]() {
+        return modules[modules_dir + "/b"].config.restart
+            .death_count_cutoff == 1;
+    }));
+    BOOST_REQUIRE(modules[modules_dir + "/b"].pid == b_pid);
+
+    // A broken config is ignored
+    write_file(config_path, "{");
+    loop.run_once(2 * RELOAD_DEBOUNCE_MS);
+    loop.run_once(2 * RELOAD_DEBOUNCE_MS);
+    BOOST_REQUIRE(modules[modules_dir + "/b"].pid == b_pid);
+    BOOST_REQUIRE(!modules[modules_dir + "/b"].retired);
+
+    kill(b_pid, SIGTERM);
+    waitpid(b_pid, NULL, 0);
+    unlink((modules_dir + "/b").c_str());
+    unlink(config_path.c_str());
+    rmdir(modules_dir.c_str());
+    rmdir(dir.c_str());
+}
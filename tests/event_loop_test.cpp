@@ -0,0 +1,94 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the driver event loop.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE event_loop
+// Child deaths are not an error
+#define BOOST_TEST_IGNORE_NON_ZERO_CHILD_CODE
+#define BOOST_TEST_IGNORE_SIGCHLD
+#include <boost/test/unit_test.hpp>
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <thread>
+
+#include "../include/event_loop.hpp"
+
+BOOST_AUTO_TEST_CASE(timer_test) {
+    EventLoop loop;
+    int fired = 0;
+    int64_t start = EventLoop::now_ms();
+    loop.schedule(20, [&]() { fired++; loop.stop(); });
+    TimerId cancelled = loop.schedule(10, [&]() { fired += 100; });
+    loop.cancel(cancelled);
+    loop.run();
+    BOOST_REQUIRE(fired == 1);
+    BOOST_REQUIRE(EventLoop::now_ms() - start >= 20);
+}
+
+BOOST_AUTO_TEST_CASE(idle_loop_blocks_test) {
+    EventLoop loop;
+    // Nothing to do, so this must time out without dispatching anything
+    BOOST_REQUIRE(loop.run_once(50) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(post_test) {
+    EventLoop loop;
+    int ran = 0;
+    std::thread poster([&]() {
+        loop.post([&]() { ran++; loop.stop(); });
+    });
+    loop.run();
+    poster.join();
+    BOOST_REQUIRE(ran == 1);
+}
+
+BOOST_AUTO_TEST_CASE(watch_fd_test) {
+    EventLoop loop;
+    int fds[2];
+    BOOST_REQUIRE(pipe(fds) == 0);
+    char got = 0;
+    BOOST_REQUIRE(loop.watch(fds[0], [&]() {
+        BOOST_REQUIRE(read(fds[0], &got, 1) == 1);
+        loop.stop();
+    }));
+    BOOST_REQUIRE(write(fds[1], "x", 1) == 1);
+    loop.run();
+    BOOST_REQUIRE(got == 'x');
+    loop.unwatch(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(sigchld_test) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    BOOST_REQUIRE(sigprocmask(SIG_BLOCK, &mask, NULL) == 0);
+
+    EventLoop loop;
+    pid_t reaped = 0;
+    BOOST_REQUIRE(loop.watch_signal(SIGCHLD, [&]() {
+        reaped = waitpid(-1, NULL, WNOHANG);
+        loop.stop();
+    }));
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(0);
+    }
+    int64_t start = EventLoop::now_ms();
+    loop.run();
+    BOOST_REQUIRE(reaped == pid);
+    // Deaths should be noticed right away, not on a polling interval
+    BOOST_REQUIRE(EventLoop::now_ms() - start < 1000);
+}
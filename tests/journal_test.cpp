@@ -0,0 +1,179 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the binary journal of supervisor events.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE journal
+// Child deaths are not an error
+#define BOOST_TEST_IGNORE_NON_ZERO_CHILD_CODE
+#define BOOST_TEST_IGNORE_SIGCHLD
+#include <boost/test/unit_test.hpp>
+
+#include <signal.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/journal.hpp"
+#include "../include/octopOS_driver.hpp"
+
+// Returns the path of a fresh, empty file
+static std::string temp_path() {
+    char path[] = "/tmp/journal_testXXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+static std::vector<JournalRecord> read_all(const std::string &path) {
+    CDH::Optional< std::vector<JournalRecord> > records = read_journal(path);
+    BOOST_REQUIRE(!records.isEmpty());
+    return records.get();
+}
+
+BOOST_AUTO_TEST_CASE(record_test) {
+    std::string path = temp_path();
+    {
+        Journal journal;
+        BOOST_REQUIRE(journal.open(path));
+        BOOST_CHECK(journal.record(JOURNAL_LAUNCH, 3, 1234));
+        BOOST_CHECK(journal.record(JOURNAL_DEATH, 3, 1234, 256));
+        journal.flush();
+
+        std::vector<JournalRecord> records = read_all(path);
+        BOOST_REQUIRE(records.size() == 3);
+        BOOST_CHECK(records[0].event == JOURNAL_DRIVER_START);
+        BOOST_CHECK(records[0].slot == JOURNAL_NO_SLOT);
+        BOOST_CHECK(records[0].pid == getpid());
+        BOOST_CHECK(records[1].event == JOURNAL_LAUNCH);
+        BOOST_CHECK(records[1].slot == 3);
+        BOOST_CHECK(records[1].pid == 1234);
+        BOOST_CHECK(records[2].event == JOURNAL_DEATH);
+        BOOST_CHECK(records[2].status == 256);
+        BOOST_CHECK(records[1].time_ns <= records[2].time_ns);
+        BOOST_CHECK(records[1].time_ns > 0);
+    }
+    // The next driver appends to the same history
+    {
+        Journal journal;
+        BOOST_REQUIRE(journal.open(path));
+        journal.record(JOURNAL_LAUNCH, 0, 99);
+    }
+    std::vector<JournalRecord> records = read_all(path);
+    BOOST_REQUIRE(records.size() == 5);
+    BOOST_CHECK(records[3].event == JOURNAL_DRIVER_START);
+    BOOST_CHECK(records[4].pid == 99);
+    unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(size_cap_test) {
+    std::string path = temp_path();
+    size_t capacity = 16;
+    size_t bytes = sizeof(JournalFileHeader) + capacity * sizeof(JournalRecord);
+    {
+        Journal journal;
+        BOOST_REQUIRE(journal.open(path, bytes));
+        for (int i = 0; i < 100; i++) {
+            journal.record(JOURNAL_LAUNCH, i, i);
+        }
+    }
+    // Only the newest records are kept
+    std::vector<JournalRecord> records = read_all(path);
+    BOOST_REQUIRE(records.size() == capacity);
+    for (size_t i = 0; i < capacity; i++) {
+        BOOST_CHECK(records[i].pid == (int)(100 - capacity + i));
+    }
+
+    // A different size starts over
+    {
+        Journal journal;
+        BOOST_REQUIRE(journal.open(path, 2 * bytes));
+    }
+    BOOST_CHECK(read_all(path).size() == 1);
+    unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_record_test) {
+    std::string path = temp_path();
+    const int threads = 4;
+    const int per_thread = 5000;
+    Journal journal;
+    BOOST_REQUIRE(journal.open(path, 4 * 1024 * 1024));
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; t++) {
+        producers.push_back(std::thread([&journal, t]() {
+            for (int i = 0; i < per_thread; i++) {
+                journal.record(JOURNAL_LAUNCH, t, i);
+                if (i % 256 == 0) {
+                    usleep(1000);
+                }
+            }
+        }));
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+    journal.flush();
+
+    // Every record is either kept, in order per thread, or counted
+    std::vector<JournalRecord> records = read_all(path);
+    std::vector<int> last(threads, -1);
+    size_t kept = 0;
+    for (const JournalRecord &record : records) {
+        if (record.event != JOURNAL_LAUNCH) {
+            continue;
+        }
+        BOOST_REQUIRE(record.slot < (uint32_t)threads);
+        BOOST_CHECK(record.pid > last[record.slot]);
+        last[record.slot] = record.pid;
+        kept++;
+    }
+    BOOST_CHECK(kept + journal.dropped() == (size_t)threads * per_thread);
+    unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(driver_events_test) {
+    std::string path = temp_path();
+    Journal journal;
+    BOOST_REQUIRE(journal.open(path));
+    set_journal(&journal);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        pause();
+        exit(0);
+    }
+    ModuleInfo modules;
+    ModuleSlot slot = modules.add("/modules/retiring", Module(pid, 1, 0));
+    modules.at(slot).retired = true;
+    BOOST_REQUIRE(kill_module("/modules/retiring", &modules) != -1);
+    while (modules.at(slot).pid == pid) {
+        reboot_dead_modules(&modules, NULL, NULL);
+        usleep(1000);
+    }
+    set_journal(NULL);
+    journal.flush();
+
+    std::vector<JournalRecord> records = read_all(path);
+    BOOST_REQUIRE(records.size() == 4);
+    BOOST_CHECK(records[1].event == JOURNAL_KILL);
+    BOOST_CHECK(records[1].status == SIGTERM);
+    BOOST_CHECK(records[2].event == JOURNAL_DEATH);
+    BOOST_CHECK(records[2].pid == pid);
+    BOOST_CHECK(WIFSIGNALED(records[2].status));
+    BOOST_CHECK(records[3].event == JOURNAL_RETIRE);
+    for (size_t i = 1; i < records.size(); i++) {
+        BOOST_CHECK(records[i].slot == slot);
+    }
+    unlink(path.c_str());
+}
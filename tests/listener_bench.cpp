@@ -0,0 +1,140 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Benchmark comparing one blocked listener thread per tentacle
+ * against the listener pool. Each tentacle is a System V message queue,
+ * as in OctopOS, fed by a few producer threads standing in for modules.
+ *
+ * Usage: listener_bench [tentacles] [messages per tentacle] [workers]
+ */
+
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../include/listener_pool.hpp"
+
+/** The message type that stops a dedicated listener thread. */
+static const long STOP_TYPE = 2;  // NOLINT
+/** The number of producer threads. */
+static const size_t PRODUCERS = 4;
+
+struct Message {
+    long type;  // NOLINT
+    char body[32];
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+static void produce(const std::vector<int> &queues, size_t per_queue) {
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < PRODUCERS; p++) {
+        producers.push_back(std::thread([&queues, per_queue, p]() {
+            Message message = {1, "telemetry"};
+            for (size_t i = 0; i < per_queue; i++) {
+                for (size_t q = p; q < queues.size(); q += PRODUCERS) {
+                    msgsnd(queues[q], &message, sizeof(message.body), 0);
+                }
+            }
+        }));
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+}
+
+// The listener model before the pool: a thread blocked in msgrcv on
+// every tentacle.
+static double dedicated_ms(const std::vector<int> &queues, size_t per_queue,
+                           std::atomic<uint64_t> *received) {
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> listeners;
+    for (int msqid : queues) {
+        listeners.push_back(std::thread([msqid, received]() {
+            Message message;
+            while (msgrcv(msqid, &message, sizeof(message.body), 0, 0) >= 0 &&
+                   message.type != STOP_TYPE) {
+                (*received)++;
+            }
+        }));
+    }
+    produce(queues, per_queue);
+    while (*received < queues.size() * per_queue) {
+        std::this_thread::yield();
+    }
+    double elapsed = ms_since(start);
+    Message stop = {STOP_TYPE, ""};
+    for (int msqid : queues) {
+        msgsnd(msqid, &stop, sizeof(stop.body), 0);
+    }
+    for (std::thread &listener : listeners) {
+        listener.join();
+    }
+    return elapsed;
+}
+
+static double pool_ms(const std::vector<int> &queues, size_t per_queue,
+                      unsigned workers, std::atomic<uint64_t> *received) {
+    Clock::time_point start = Clock::now();
+    ListenerPool pool(queues.size(), workers);
+    for (size_t q = 0; q < queues.size(); q++) {
+        pool.add(q, serve_message_queue(queues[q], sizeof(Message::body),
+            [received](int, long, const char*, size_t) {  // NOLINT
+                (*received)++;
+            }));
+    }
+    produce(queues, per_queue);
+    while (*received < queues.size() * per_queue) {
+        std::this_thread::yield();
+    }
+    return ms_since(start);
+}
+
+int main(int argc, char *argv[]) {
+    size_t tentacles = argc > 1 ? atoi(argv[1]) : 256;
+    size_t per_queue = argc > 2 ? atoi(argv[2]) : 200;
+    unsigned workers = argc > 3 ? atoi(argv[3]) : 0;
+
+    std::vector<int> queues;
+    for (size_t i = 0; i < tentacles; i++) {
+        int msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+        if (msqid == -1) {
+            perror("msgget");
+            return 1;
+        }
+        queues.push_back(msqid);
+    }
+
+    std::atomic<uint64_t> received(0);
+    double dedicated = dedicated_ms(queues, per_queue, &received);
+    received = 0;
+    double pooled = pool_ms(queues, per_queue, workers, &received);
+    ListenerPool sizing(1, workers);
+
+    double total = tentacles * per_queue;
+    printf("%zu tentacles, %zu messages each:\n", tentacles, per_queue);
+    printf("  thread per tentacle  %5zu threads  %8.1f ms  %10.0f msg/s\n",
+           tentacles, dedicated, total * 1000 / dedicated);
+    printf("  listener pool        %5zu threads  %8.1f ms  %10.0f msg/s\n",
+           sizing.worker_count(), pooled, total * 1000 / pooled);
+
+    for (int msqid : queues) {
+        msgctl(msqid, IPC_RMID, NULL);
+    }
+    return 0;
+}
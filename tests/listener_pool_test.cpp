@@ -0,0 +1,93 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the tentacle listener pool.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE listener_pool
+#include <boost/test/unit_test.hpp>
+
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "../include/listener_pool.hpp"
+
+// Waits up to a second for COUNTER to reach N
+static bool wait_for(const std::atomic<int> &counter, int n) {
+    for (int i = 0; i < 1000 && counter < n; i++) {
+        usleep(1000);
+    }
+    return counter == n;
+}
+
+BOOST_AUTO_TEST_CASE(serve_test) {
+    ListenerPool pool(8, 2);
+    BOOST_REQUIRE(pool.worker_count() == 2);
+    std::atomic<int> waiting(5), served(0);
+    auto serve = [&](int, size_t budget) {
+        size_t n = 0;
+        while (n < budget && waiting > 0) {
+            waiting--;
+            served++;
+            n++;
+        }
+        return n;
+    };
+    BOOST_REQUIRE(pool.add(3, serve));
+    BOOST_REQUIRE(!pool.add(3, serve));  // already served
+    BOOST_REQUIRE(!pool.add(8, serve));  // out of range
+    BOOST_REQUIRE(pool.tentacle_count() == 1);
+    BOOST_REQUIRE(wait_for(served, 5));
+
+    waiting = 3;
+    pool.notify(3);
+    BOOST_REQUIRE(wait_for(served, 8));
+    BOOST_REQUIRE(pool.messages_served() == 8);
+
+    BOOST_REQUIRE(pool.remove(3));
+    BOOST_REQUIRE(!pool.remove(3));
+    waiting = 1;
+    pool.notify(3);
+    usleep(20 * 1000);
+    BOOST_REQUIRE(served == 8);
+    BOOST_REQUIRE(pool.tentacle_count() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(message_queue_test) {
+    int msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    BOOST_REQUIRE(msqid != -1);
+    std::atomic<int> received(0);
+    std::string last;
+    ListenerPool pool(4, 1);
+    BOOST_REQUIRE(pool.add(1, serve_message_queue(msqid, 64,
+        [&](int tentacle, long type, const char *body, size_t size) {  // NOLINT
+            BOOST_CHECK(tentacle == 1);
+            BOOST_CHECK(type == 7);
+            last.assign(body, size);
+            received++;
+        })));
+
+    struct { long type; char body[64]; } message;  // NOLINT
+    message.type = 7;
+    for (int i = 0; i < 40; i++) {
+        std::string body = "message " + std::to_string(i);
+        memcpy(message.body, body.c_str(), body.size());
+        BOOST_REQUIRE(msgsnd(msqid, &message, body.size(), 0) == 0);
+    }
+    pool.notify(1);
+    BOOST_REQUIRE(wait_for(received, 40));
+    BOOST_REQUIRE(last == "message 39");
+    msgctl(msqid, IPC_RMID, NULL);
+}
@@ -0,0 +1,275 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the Mediator.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE mediator
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <thread>
+
+#include "../include/mediator/example_mediator.hpp"
+
+struct Attitude {
+    double quaternion[4];
+};
+
+struct Health {
+    int status;
+};
+
+typedef Topic<topic_id("test.attitude"), Attitude, 4> AttitudeTopic;
+typedef Topic<topic_id("test.health"), Health> HealthTopic;
+
+typedef Topic<topic_id("test.latest"), Health, 8, Latest> LatestTopic;
+typedef Topic<topic_id("test.drop"), Health, 8, DropOldest<2> > DropTopic;
+
+typedef Mediator<Inputs<>, Outputs<AttitudeTopic, HealthTopic> >
+    SensorMediator;
+typedef Mediator<Inputs<AttitudeTopic, HealthTopic>, Outputs<> >
+    ControlMediator;
+
+static_assert(topic_id("test.attitude") != topic_id("test.health"),
+              "Topic IDs are computed at compile time");
+static_assert(!distinct_topic_ids<AttitudeTopic, HealthTopic,
+                                  AttitudeTopic>::value,
+              "Duplicate topic IDs are detected");
+
+struct UnlinkTopics {
+    UnlinkTopics() { unlink_all(); }
+    ~UnlinkTopics() { unlink_all(); }
+    void unlink_all() {
+        shm_unlink(shm_ring_name(topic_ring_name(AttitudeTopic::id)).c_str());
+        shm_unlink(shm_ring_name(topic_ring_name(HealthTopic::id)).c_str());
+        shm_unlink(shm_ring_name(topic_ring_name(LatestTopic::id)).c_str());
+        shm_unlink(shm_ring_name(topic_ring_name(DropTopic::id)).c_str());
+        shm_unlink(shm_ring_name(topic_ring_name(ExampleXTopic::id)).c_str());
+        shm_unlink(
+            shm_ring_name(topic_ring_name(ExampleMsgTopic::id)).c_str());
+        for (MemKey key = 1; key <= 5; key++) {
+            shm_unlink(shm_doorbell_name(key).c_str());
+        }
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(example_mediator_test, UnlinkTopics) {
+    typedef Mediator<Inputs<ExampleMsgTopic>, Outputs<ExampleXTopic> >
+        ExampleTester;
+    ExampleTester tester = ExampleTester::create(2);
+    BOOST_REQUIRE(tester.init());
+    ExampleMediator mediator = ExampleMediator::create(1);
+    BOOST_REQUIRE(mediator.init());
+    tester.yield();  // example.msg now exists
+
+    ExampleTester::OutData x = {42};
+    tester.publish_data(x);
+    ExampleMediator::InData in;
+    mediator.yield();
+    // Not published until the publisher yields
+    BOOST_REQUIRE(mediator.get_data(&in) == 0);
+    tester.yield();
+    BOOST_REQUIRE(mediator.get_data(&in) == 1);
+    BOOST_REQUIRE(in.x == 42);
+    BOOST_REQUIRE(mediator.get_data(&in) == 0);
+
+    ExampleMediator::OutData out;
+    snprintf(out.msg, sizeof(out.msg), "x is %d", in.x);
+    mediator.publish_data(out);
+    mediator.yield();
+    ExampleTester::InData msg;
+    BOOST_REQUIRE(tester.get_data(&msg) == 1);
+    BOOST_REQUIRE(std::string(msg.msg) == "x is 42");
+}
+
+BOOST_FIXTURE_TEST_CASE(topics_test, UnlinkTopics) {
+    SensorMediator sensor = SensorMediator::create(1);
+    ControlMediator control = ControlMediator::create(2);
+    BOOST_REQUIRE(control.init());  // before anything is published
+    BOOST_REQUIRE(sensor.init());
+    control.yield();
+
+    Attitude attitude = {{1, 0, 0, 0}};
+    Health health = {7};
+    sensor.publish_data<HealthTopic>(health);
+    sensor.publish_data<AttitudeTopic>(attitude);
+    sensor.yield();
+
+    Attitude attitude_in;
+    Health health_in;
+    BOOST_REQUIRE(control.get_data<AttitudeTopic>(&attitude_in) == 1);
+    BOOST_REQUIRE(attitude_in.quaternion[0] == 1);
+    BOOST_REQUIRE(control.get_data<AttitudeTopic>(&attitude_in) == 0);
+    BOOST_REQUIRE(control.get_data<HealthTopic>(&health_in) == 1);
+    BOOST_REQUIRE(health_in.status == 7);
+}
+
+BOOST_FIXTURE_TEST_CASE(full_queue_test, UnlinkTopics) {
+    SensorMediator sensor = SensorMediator::create(1);
+    BOOST_REQUIRE(sensor.init());
+    ControlMediator control = ControlMediator::create(2);
+    BOOST_REQUIRE(control.init());
+
+    // A whole ring's worth is published without waiting for yield
+    Attitude attitude = {{0, 0, 0, 0}};
+    for (int i = 0; i < 4; i++) {
+        attitude.quaternion[0] = i;
+        sensor.publish_data<AttitudeTopic>(attitude);
+    }
+    Attitude in;
+    for (int i = 0; i < 4; i++) {
+        BOOST_REQUIRE(control.get_data<AttitudeTopic>(&in) == 1);
+        BOOST_REQUIRE(in.quaternion[0] == i);
+    }
+    // Past that, the slowest readers lose the oldest messages
+    for (int i = 4; i < 10; i++) {
+        attitude.quaternion[0] = i;
+        sensor.publish_data<AttitudeTopic>(attitude);
+    }
+    sensor.yield();
+    BOOST_REQUIRE(control.get_data<AttitudeTopic>(&in) == 1);
+    BOOST_REQUIRE(in.quaternion[0] == 6);
+    BOOST_REQUIRE(control.dropped<AttitudeTopic>() == 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(taken_topic_test, UnlinkTopics) {
+    SensorMediator sensor = SensorMediator::create(1);
+    BOOST_REQUIRE(sensor.init());
+    // Another module can't publish the same topics
+    SensorMediator impostor = SensorMediator::create(5);
+    BOOST_REQUIRE(!impostor.init());
+    // But the same module, relaunched, can
+    SensorMediator relaunched = SensorMediator::create(1);
+    BOOST_REQUIRE(relaunched.init());
+}
+
+BOOST_FIXTURE_TEST_CASE(wait_test, UnlinkTopics) {
+    typedef std::chrono::steady_clock Clock;
+    SensorMediator sensor = SensorMediator::create(1);
+    BOOST_REQUIRE(sensor.init());
+    ControlMediator control = ControlMediator::create(2);
+    BOOST_REQUIRE(control.init());
+
+    BOOST_REQUIRE(!control.wait(20));
+
+    // Woken by the publish, not by polling
+    std::thread publisher([&sensor]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Health health = {1};
+        sensor.publish_data<HealthTopic>(health);
+        sensor.yield();
+    });
+    Clock::time_point start = Clock::now();
+    BOOST_REQUIRE(control.wait());
+    double waited_ms = std::chrono::duration<double, std::milli>(
+        Clock::now() - start).count();
+    publisher.join();
+    BOOST_REQUIRE(waited_ms >= 40);
+    BOOST_REQUIRE(waited_ms < MEDIATOR_OPEN_RETRY_MS);
+    Health health;
+    BOOST_REQUIRE(control.get_data<HealthTopic>(&health) == 1);
+    BOOST_REQUIRE(!control.wait(0));
+}
+
+BOOST_FIXTURE_TEST_CASE(late_publisher_test, UnlinkTopics) {
+    ControlMediator control = ControlMediator::create(2);
+    BOOST_REQUIRE(control.init());
+    // Topics published after init are picked up while waiting
+    std::thread publisher([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        SensorMediator sensor = SensorMediator::create(1);
+        sensor.init();
+        Health health = {1};
+        sensor.publish_data<HealthTopic>(health);
+        sensor.yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    });
+    bool woken = control.wait(2000);
+    publisher.join();
+    BOOST_REQUIRE(woken);
+}
+
+BOOST_FIXTURE_TEST_CASE(handler_test, UnlinkTopics) {
+    SensorMediator sensor = SensorMediator::create(1);
+    BOOST_REQUIRE(sensor.init());
+    ControlMediator control = ControlMediator::create(2);
+    BOOST_REQUIRE(control.init());
+
+    int attitudes = 0, last_status = 0;
+    control.on<AttitudeTopic>([&attitudes](const Attitude &) {
+        attitudes++;
+    });
+    control.on<HealthTopic>([&control, &last_status](const Health &health) {
+        last_status = health.status;
+        if (health.status == 3) {
+            control.stop();
+        }
+    });
+    std::thread publisher([&sensor]() {
+        Attitude attitude = {{1, 0, 0, 0}};
+        for (int status = 1; status <= 3; status++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            Health health = {status};
+            sensor.publish_data<AttitudeTopic>(attitude);
+            sensor.publish_data<HealthTopic>(health);
+            sensor.yield();
+        }
+    });
+    control.run();
+    publisher.join();
+    BOOST_REQUIRE(last_status == 3);
+    BOOST_REQUIRE(attitudes == 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(delivery_test, UnlinkTopics) {
+    typedef Mediator<Inputs<>, Outputs<HealthTopic, LatestTopic, DropTopic> >
+        Publisher;
+    typedef Mediator<Inputs<HealthTopic, LatestTopic, DropTopic>, Outputs<> >
+        Reader;
+    Publisher publisher = Publisher::create(1);
+    BOOST_REQUIRE(publisher.init());
+    Reader reader = Reader::create(2);
+    BOOST_REQUIRE(reader.init());
+
+    for (int status = 1; status <= 5; status++) {
+        Health health = {status};
+        publisher.publish_data<HealthTopic>(health);
+        publisher.publish_data<LatestTopic>(health);
+        publisher.publish_data<DropTopic>(health);
+    }
+    publisher.yield();
+    publisher.yield();  // nothing left to publish
+
+    Health health;
+    // Batched: all of them, at once
+    for (int status = 1; status <= 5; status++) {
+        BOOST_REQUIRE(reader.get_data<HealthTopic>(&health) == 1);
+        BOOST_REQUIRE(health.status == status);
+    }
+    BOOST_REQUIRE(publisher.stats<HealthTopic>().published == 5);
+    BOOST_REQUIRE(publisher.stats<HealthTopic>().batches == 1);
+
+    // Latest: only the newest
+    BOOST_REQUIRE(reader.get_data<LatestTopic>(&health) == 1);
+    BOOST_REQUIRE(health.status == 5);
+    BOOST_REQUIRE(reader.get_data<LatestTopic>(&health) == 0);
+    BOOST_REQUIRE(publisher.stats<LatestTopic>().published == 1);
+    BOOST_REQUIRE(publisher.stats<LatestTopic>().coalesced == 4);
+
+    // DropOldest: the newest 2
+    BOOST_REQUIRE(reader.get_data<DropTopic>(&health) == 1);
+    BOOST_REQUIRE(health.status == 4);
+    BOOST_REQUIRE(reader.get_data<DropTopic>(&health) == 1);
+    BOOST_REQUIRE(health.status == 5);
+    BOOST_REQUIRE(reader.get_data<DropTopic>(&health) == 0);
+    BOOST_REQUIRE(publisher.stats<DropTopic>().published == 2);
+    BOOST_REQUIRE(publisher.stats<DropTopic>().dropped == 3);
+}
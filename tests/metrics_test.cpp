@@ -0,0 +1,179 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the driver's counters, histograms and metrics socket.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE metrics
+#include <boost/test/unit_test.hpp>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/metrics.hpp"
+#include "../include/metrics_server.hpp"
+
+BOOST_AUTO_TEST_CASE(bucket_test) {
+    size_t last = 0;
+    for (uint64_t value = 0; value < 100000; value++) {
+        size_t bucket = LatencyHistogram::bucket_of(value);
+        BOOST_REQUIRE(bucket >= last);
+        BOOST_REQUIRE(bucket < HISTOGRAM_BUCKETS);
+        uint64_t bound = LatencyHistogram::upper_bound_of(bucket);
+        BOOST_REQUIRE(bound >= value);
+        // At most 1/8 too big
+        BOOST_REQUIRE(bound - value <= value / 8);
+        last = bucket;
+    }
+    BOOST_CHECK(LatencyHistogram::bucket_of(UINT64_MAX) ==
+                HISTOGRAM_BUCKETS - 1);
+    BOOST_CHECK(LatencyHistogram::upper_bound_of(HISTOGRAM_BUCKETS - 1) ==
+                UINT64_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_test) {
+    LatencyHistogram histogram;
+    BOOST_CHECK(histogram.quantile(0.5) == 0);
+    for (int us = 1; us <= 1000; us++) {
+        histogram.record(us);
+    }
+    histogram.record(-5);
+    BOOST_CHECK(histogram.count() == 1001);
+    BOOST_CHECK(histogram.sum() == 500500);
+    BOOST_CHECK(histogram.max() == 1000);
+    uint64_t median = histogram.quantile(0.5);
+    BOOST_CHECK(median >= 500 && median <= 500 + 500 / 8);
+    uint64_t p99 = histogram.quantile(0.99);
+    BOOST_CHECK(p99 >= 990 && p99 <= 1000);
+    BOOST_CHECK(histogram.quantile(1) == 1000);
+    BOOST_CHECK(histogram.quantile(0) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_record_test) {
+    LatencyHistogram histogram;
+    Counter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&histogram, &counter]() {
+            for (int i = 0; i < 100000; i++) {
+                histogram.record(i % 1000);
+                counter.add();
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK(counter.get() == 400000);
+    BOOST_CHECK(histogram.count() == 400000);
+    BOOST_CHECK(histogram.sum() == 4 * 100 * 499500ULL);
+    BOOST_CHECK(histogram.max() == 999);
+}
+
+BOOST_AUTO_TEST_CASE(write_metrics_test) {
+    SupervisorMetrics metrics;
+    metrics.deaths.add(3);
+    metrics.spawn_us.record(1500);
+    ModuleRegistry modules;
+    modules.add("/modules/\"quoted\"", Module(42, 1, 0));
+    modules.add("/modules/down", Module(-1, 2, 0));
+    modules.at(0).death_count = 2;
+
+    std::ostringstream out;
+    write_metrics(out, metrics, &modules);
+    std::string text = out.str();
+    BOOST_CHECK(text.find("# TYPE octopos_deaths_total counter\n"
+                          "octopos_deaths_total 3\n") != std::string::npos);
+    BOOST_CHECK(text.find("octopos_spawn_duration_seconds_count 1\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_spawn_duration_seconds_max 0.001500\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_modules{state=\"running\"} 1\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_modules{state=\"down\"} 1\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_module_deaths_total{module="
+                          "\"/modules/\\\"quoted\\\"\"} 2\n") !=
+                std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(cgroup_metrics_test) {
+    // A directory with the files of a cgroup stands in for one
+    std::string cgroup = "/tmp/metrics_test_cgroup." + std::to_string(getpid());
+    BOOST_REQUIRE(mkdir(cgroup.c_str(), 0755) == 0);
+    std::ofstream(cgroup + "/cpu.stat") << "usage_usec 2500000\n"
+        "user_usec 2000000\nnr_throttled 3\nthrottled_usec 500000\n";
+    std::ofstream(cgroup + "/memory.current") << "4096\n";
+    std::ofstream(cgroup + "/memory.events") << "low 0\noom 1\noom_kill 1\n";
+    ModuleRegistry modules;
+    modules.add("/modules/limited", Module(42, 1, 0));
+    modules.add("/modules/unlimited", Module(43, 2, 0));
+    modules.at(0).cgroup = cgroup;
+
+    std::ostringstream out;
+    write_metrics(out, SupervisorMetrics(), &modules);
+    std::string text = out.str();
+    BOOST_CHECK(text.find("octopos_cgroup_cpu_seconds_total{module="
+                          "\"/modules/limited\"} 2.500000\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_cgroup_throttled_seconds_total{module="
+                          "\"/modules/limited\"} 0.500000\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_cgroup_memory_bytes{module="
+                          "\"/modules/limited\"} 4096\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_cgroup_oom_kills_total{module="
+                          "\"/modules/limited\"} 1\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("octopos_cgroup_cpu_seconds_total{module="
+                          "\"/modules/unlimited\"}") == std::string::npos);
+    system(("rm -r " + cgroup).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(metrics_server_test) {
+    std::string path = "/tmp/metrics_test." + std::to_string(getpid());
+    ModuleRegistry modules;
+    EventLoop loop;
+    {
+        MetricsServer server(&loop, &modules);
+        BOOST_REQUIRE(server.start(path));
+        supervisor_metrics().restarts.add();
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        BOOST_REQUIRE(connect(fd, (struct sockaddr*)&address,
+                              sizeof(address)) == 0);
+        BOOST_REQUIRE(loop.run_once(1000) > 0);
+
+        std::string text;
+        char buffer[4096];
+        ssize_t size;
+        while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+            text.append(buffer, size);
+        }
+        close(fd);
+        BOOST_CHECK(text.find("octopos_restarts_total 1\n") !=
+                    std::string::npos);
+    }
+    // The socket is removed with the server
+    BOOST_CHECK(access(path.c_str(), F_OK) == -1);
+}
@@ -0,0 +1,143 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for config parsing and per-module settings.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE module_config
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../include/json.hpp"
+#include "../include/module_config.hpp"
+
+BOOST_AUTO_TEST_CASE(json_parse_test) {
+    std::istringstream in(
+        "{\"s\": \"a\\\"b\", \"n\": -1.5e1, \"t\": true, \"z\": null,"
+        " \"a\": [1, 2, {\"x\": []}], \"o\": {}}");
+    json j = json::parse(in);
+    BOOST_REQUIRE(j.is_object());
+    BOOST_REQUIRE(j["s"] == "a\"b");
+    BOOST_REQUIRE(j.value("n", 0.0) == -15);
+    BOOST_REQUIRE(j.value("t", false));
+    BOOST_REQUIRE(j["z"].is_null());
+    BOOST_REQUIRE(j["a"].size() == 3);
+    BOOST_REQUIRE(j["a"][2]["x"].is_array());
+    BOOST_REQUIRE(j["o"].is_object());
+    // Missing or mistyped values fall back to the default
+    BOOST_REQUIRE(j.value("missing", 7) == 7);
+    BOOST_REQUIRE(j.value("s", 7) == 7);
+    BOOST_REQUIRE(j["missing"]["deeper"].is_null());
+    std::string s = j["s"];
+    BOOST_REQUIRE(s == "a\"b");
+}
+
+BOOST_AUTO_TEST_CASE(json_invalid_test) {
+    BOOST_REQUIRE_THROW(json::parse(std::string("{\"a\": }")),
+                        std::invalid_argument);
+    BOOST_REQUIRE_THROW(json::parse(std::string("[1, 2")),
+                        std::invalid_argument);
+    BOOST_REQUIRE_THROW(json::parse(std::string("{} x")),
+                        std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(json_copies_are_independent_test) {
+    json a = json::parse(std::string("{\"x\": {\"y\": 1}}"));
+    json b = a;
+    b["x"]["y"] = 2;
+    BOOST_REQUIRE(a["x"].value("y", 0) == 1);
+    BOOST_REQUIRE(b["x"].value("y", 0) == 2);
+}
+
+BOOST_AUTO_TEST_CASE(module_config_for_test) {
+    json config = json::parse(std::string(
+        "{\"module_defaults\": {\"restart\": {\"initial_delay_ms\": 50}},"
+        " \"modules\": {\"gps\": {\"restart\": {\"multiplier\": 4,"
+        "                                        \"death_count_cutoff\": 2}}}}"));
+    ModuleConfig gps = module_config_for(config, "/modules/gps");
+    BOOST_REQUIRE(gps.restart.initial_delay_ms == 50);
+    BOOST_REQUIRE(gps.restart.multiplier == 4);
+    BOOST_REQUIRE(gps.restart.death_count_cutoff == 2);
+    BOOST_REQUIRE(gps.restart.runtime_cutoff_s == RUNTIME_CUTOFF_DOWNGRADE_S);
+
+    ModuleConfig other = module_config_for(config, "/modules/other");
+    BOOST_REQUIRE(other.restart.initial_delay_ms == 50);
+    BOOST_REQUIRE(other.restart.death_count_cutoff ==
+                  DEATH_COUNT_CUTOFF_DOWNGRADE);
+
+    ModuleConfig unconfigured = module_config_for(json(), "/modules/gps");
+    BOOST_REQUIRE(unconfigured.restart.initial_delay_ms ==
+                  RestartPolicy().initial_delay_ms);
+}
+
+BOOST_AUTO_TEST_CASE(watchdog_config_test) {
+    json config = json::parse(std::string(
+        "{\"module_defaults\": {\"watchdog\": {\"startup_grace_ms\": 3000}},"
+        " \"modules\": {\"gps\": {\"watchdog\": {\"timeout_ms\": 500}}}}"));
+    ModuleConfig gps = module_config_for(config, "/modules/gps");
+    BOOST_REQUIRE(gps.watchdog.timeout_ms == 500);
+    BOOST_REQUIRE(gps.watchdog.startup_grace_ms == 3000);
+
+    // Not watched unless configured
+    ModuleConfig other = module_config_for(config, "/modules/other");
+    BOOST_REQUIRE(other.watchdog.timeout_ms == 0);
+    BOOST_REQUIRE(other != gps);
+    BOOST_REQUIRE(module_config_for(json(), "/modules/gps").watchdog ==
+                  WatchdogPolicy());
+}
+
+BOOST_AUTO_TEST_CASE(resources_config_test) {
+    json config = json::parse(std::string(
+        "{\"module_defaults\": {\"resources\": {\"nice\": 5}},"
+        " \"modules\": {\"gps\": {\"resources\": {\"cpu_max_percent\": 25,"
+        "    \"memory_max_kb\": 4096, \"cpus\": [0, 2, -1],"
+        "    \"io_class\": \"idle\"}}}}"));
+    ModuleConfig gps = module_config_for(config, "/modules/gps");
+    BOOST_REQUIRE(gps.resources.cpu_max_percent == 25);
+    BOOST_REQUIRE(gps.resources.memory_max_kb == 4096);
+    // Negative CPUs are left out
+    BOOST_REQUIRE(gps.resources.cpus == std::vector<int>({0, 2}));
+    BOOST_REQUIRE(gps.resources.nice == 5);
+    BOOST_REQUIRE(gps.resources.io_class == "idle");
+    BOOST_REQUIRE(gps.resources.io_priority == 4);
+    BOOST_REQUIRE(gps.resources.cgroup_root == CGROUP_ROOT);
+    BOOST_REQUIRE(gps.resources.needs_cgroup());
+
+    // Niceness alone doesn't need a cgroup
+    ModuleConfig other = module_config_for(config, "/modules/other");
+    BOOST_REQUIRE(other.resources.nice == 5);
+    BOOST_REQUIRE(!other.resources.needs_cgroup());
+    BOOST_REQUIRE(other != gps);
+    BOOST_REQUIRE(module_config_for(json(), "/modules/gps").resources ==
+                  ResourcePolicy());
+}
+
+BOOST_AUTO_TEST_CASE(restart_delay_test) {
+    RestartPolicy policy;
+    policy.initial_delay_ms = 100;
+    policy.multiplier = 2;
+    policy.max_delay_ms = 1000;
+    policy.jitter = 0;
+    // Healthy modules, and the first crash in a row, restart right away
+    BOOST_REQUIRE(restart_delay_ms(policy, 0, 0.5) == 0);
+    BOOST_REQUIRE(restart_delay_ms(policy, 1, 0.5) == 0);
+    BOOST_REQUIRE(restart_delay_ms(policy, 2, 0.5) == 100);
+    BOOST_REQUIRE(restart_delay_ms(policy, 3, 0.5) == 200);
+    BOOST_REQUIRE(restart_delay_ms(policy, 5, 0.5) == 800);
+    BOOST_REQUIRE(restart_delay_ms(policy, 6, 0.5) == 1000);
+    BOOST_REQUIRE(restart_delay_ms(policy, 1000, 0.5) == 1000);
+
+    policy.jitter = 0.5;
+    BOOST_REQUIRE(restart_delay_ms(policy, 2, 0.0) == 50);
+    BOOST_REQUIRE(restart_delay_ms(policy, 2, 0.999) >= 149);
+}
@@ -0,0 +1,93 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Microbenchmark comparing PID lookups in the module registry
+ * against the linear scan over a std::map that it replaced. Simulates
+ * a death storm: every module dies and is relaunched with a new pid.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../include/module_registry.hpp"
+
+typedef std::map<std::string, Module> OldModuleInfo;
+
+/** The number of death storms to average over. */
+static const int STORMS = 20;
+
+static std::string module_path(int i) {
+    return "/usr/local/lib/octopOS/modules/module_" + std::to_string(i);
+}
+
+// The reap path as it was before the registry: one find_if over the
+// map per dead pid, copying every element into the lambda.
+static double old_storm_ns(int n) {
+    OldModuleInfo modules;
+    for (int i = 0; i < n; i++) {
+        modules[module_path(i)] = Module(1000 + i, i + 1, 0);
+    }
+    pid_t next_pid = 1000 + n;
+    auto start = std::chrono::steady_clock::now();
+    for (int storm = 0; storm < STORMS; storm++) {
+        std::vector<pid_t> dead;
+        for (auto &m : modules) {
+            dead.push_back(m.second.pid);
+        }
+        for (pid_t pid : dead) {
+            auto it = std::find_if(modules.begin(), modules.end(),
+                                   [&pid](const std::pair<std::string, Module> el) {
+                                       return el.second.pid == pid;
+                                   });
+            modules[it->first].pid = next_pid++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           (STORMS * n);
+}
+
+static double registry_storm_ns(int n) {
+    ModuleRegistry modules;
+    for (int i = 0; i < n; i++) {
+        modules.add(module_path(i), Module(1000 + i, i + 1, 0));
+    }
+    pid_t next_pid = 1000 + n;
+    auto start = std::chrono::steady_clock::now();
+    for (int storm = 0; storm < STORMS; storm++) {
+        std::vector<pid_t> dead;
+        for (ModuleSlot slot = 0; slot < modules.size(); slot++) {
+            dead.push_back(modules.at(slot).pid);
+        }
+        for (pid_t pid : dead) {
+            ModuleSlot slot = modules.slot_with(pid).get();
+            modules.at(slot).pid = next_pid++;
+            modules.reindex(slot);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           (STORMS * n);
+}
+
+int main() {
+    const int sizes[] = {10, 100, 1000};
+    printf("%8s %16s %16s %8s\n", "modules", "map ns/reap", "registry ns/reap",
+           "speedup");
+    for (int n : sizes) {
+        double old_ns = old_storm_ns(n);
+        double new_ns = registry_storm_ns(n);
+        printf("%8d %16.1f %16.1f %7.1fx\n", n, old_ns, new_ns, old_ns / new_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the module registry.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE module_registry
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <utility>
+
+#include "../include/module_registry.hpp"
+
+BOOST_AUTO_TEST_CASE(lookup_test) {
+    ModuleRegistry modules = {
+        {"a", Module(111, 1, 1)},
+        {"b", Module(222, 2, 1)},
+        {"c", Module(333, 3, 1)}
+    };
+    BOOST_REQUIRE(modules.size() == 3);
+    BOOST_REQUIRE(modules.slot_with(5).isEmpty());
+    BOOST_REQUIRE(modules.path_of(modules.slot_with(222).get()) == "b");
+    BOOST_REQUIRE(modules.slot_of("c").get() == modules.slot_with(333).get());
+    BOOST_REQUIRE(modules.slot_of("d").isEmpty());
+    BOOST_REQUIRE(modules["a"].tentacle_id == 1);
+}
+
+BOOST_AUTO_TEST_CASE(slots_are_stable_test) {
+    ModuleRegistry modules;
+    ModuleSlot a = modules.add("a", Module(111, 1, 1));
+    ModuleSlot b = modules.add("b", Module(222, 2, 1));
+    // Replacing a module keeps its slot
+    BOOST_REQUIRE(modules.add("a", Module(444, 1, 2)) == a);
+    BOOST_REQUIRE(modules.intern("b") == b);
+    BOOST_REQUIRE(modules.size() == 2);
+    BOOST_REQUIRE(modules.slot_with(111).isEmpty());
+    BOOST_REQUIRE(modules.slot_with(444).get() == a);
+}
+
+BOOST_AUTO_TEST_CASE(reindex_test) {
+    ModuleRegistry modules = {{"a", Module(111, 1, 1)}};
+    ModuleSlot a = modules.slot_of("a").get();
+    modules.at(a).pid = 555;
+    modules.reindex(a);
+    BOOST_REQUIRE(modules.slot_with(111).isEmpty());
+    BOOST_REQUIRE(modules.slot_with(555).get() == a);
+}
+
+BOOST_AUTO_TEST_CASE(stale_index_test) {
+    ModuleRegistry modules = {{"a", Module(111, 1, 1)}};
+    // Mutate without reindexing; lookups must still be correct
+    modules["a"].pid = 666;
+    BOOST_REQUIRE(modules.slot_with(111).isEmpty());
+    BOOST_REQUIRE(!modules.slot_with(666).isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(iteration_test) {
+    ModuleRegistry modules = {
+        {"a", Module(111, 1, 1)},
+        {"b", Module(222, 2, 1)}
+    };
+    int seen = 0;
+    for (std::pair<std::string, Module> m : modules) {
+        BOOST_REQUIRE(modules[m.first].pid == m.second.pid);
+        seen++;
+    }
+    BOOST_REQUIRE(seen == 2);
+}
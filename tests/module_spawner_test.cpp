@@ -0,0 +1,110 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the module spawner.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE module_spawner
+// Child deaths are not an error
+#define BOOST_TEST_IGNORE_NON_ZERO_CHILD_CODE
+#define BOOST_TEST_IGNORE_SIGCHLD
+#include <boost/test/unit_test.hpp>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <signal.h>
+#include <cerrno>
+#include <unistd.h>
+#include <vector>
+
+#include "../include/module_spawner.hpp"
+
+BOOST_AUTO_TEST_CASE(spawn_module_test) {
+    pid_t pid = spawn_module("./modules/test_module", 0);
+    BOOST_REQUIRE(pid > 1);
+    sleep(1);
+    BOOST_REQUIRE(kill(pid, SIGTERM) == 0);
+    BOOST_REQUIRE(waitpid(pid, NULL, 0) == pid);
+}
+
+BOOST_AUTO_TEST_CASE(spawn_missing_module_test) {
+    BOOST_REQUIRE(spawn_module("./thisfiledoesntexist!.88", 0) == -1);
+    BOOST_REQUIRE(errno == ENOENT);
+    // Not executable
+    BOOST_REQUIRE(spawn_module("./test.json", 0) == -1);
+    BOOST_REQUIRE(errno == EACCES);
+}
+
+BOOST_AUTO_TEST_CASE(spawn_modules_test) {
+    std::vector<SpawnRequest> requests;
+    for (int i = 0; i < 20; i++) {
+        requests.push_back(SpawnRequest("/bin/true", i));
+    }
+    requests.push_back(SpawnRequest("./thisfiledoesntexist!.88", 20));
+    std::vector<SpawnResult> results = spawn_modules(requests, 4);
+    BOOST_REQUIRE(results.size() == requests.size());
+    for (size_t i = 0; i < 20; i++) {
+        BOOST_REQUIRE(results[i].pid > 1);
+        BOOST_REQUIRE(results[i].error == 0);
+        BOOST_REQUIRE(waitpid(results[i].pid, NULL, 0) == results[i].pid);
+    }
+    BOOST_REQUIRE(results[20].pid == -1);
+    BOOST_REQUIRE(results[20].error == ENOENT);
+}
+
+BOOST_AUTO_TEST_CASE(child_signal_mask_test) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    BOOST_REQUIRE(sigprocmask(SIG_BLOCK, &mask, NULL) == 0);
+    // The child must not inherit the blocked SIGCHLD
+    pid_t pid = spawn_module("./modules/test_module", 0);
+    BOOST_REQUIRE(pid > 1);
+    sleep(1);
+    FILE *status = fopen(("/proc/" + std::to_string(pid) + "/status").c_str(),
+                         "r");
+    BOOST_REQUIRE(status != NULL);
+    char line[256];
+    unsigned long long blocked = ~0ULL;
+    while (fgets(line, sizeof(line), status)) {
+        sscanf(line, "SigBlk: %llx", &blocked);
+    }
+    fclose(status);
+    BOOST_REQUIRE((blocked & (1ULL << (SIGCHLD - 1))) == 0);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+BOOST_AUTO_TEST_CASE(spawn_options_test) {
+    SpawnOptions options;
+    options.nice = 7;
+    options.cpus.push_back(0);
+    pid_t pid = spawn_module("./modules/test_module", 0, options);
+    BOOST_REQUIRE(pid > 1);
+    // The niceness is set before exec, so it is already in place
+    errno = 0;
+    BOOST_CHECK(getpriority(PRIO_PROCESS, pid) == 7);
+    BOOST_CHECK(errno == 0);
+    cpu_set_t cpus;
+    BOOST_REQUIRE(sched_getaffinity(pid, sizeof(cpus), &cpus) == 0);
+    BOOST_CHECK(CPU_COUNT(&cpus) == 1 && CPU_ISSET(0, &cpus));
+    kill(pid, SIGTERM);
+    BOOST_REQUIRE(waitpid(pid, NULL, 0) == pid);
+
+    // Failing to apply an option fails the spawn, like a failed exec
+    SpawnOptions invalid;
+    invalid.ioprio = 7 << 13;
+    BOOST_REQUIRE(spawn_module("./modules/test_module", 0, invalid) == -1);
+    BOOST_REQUIRE(errno == EINVAL);
+    BOOST_REQUIRE(spawn_module("./thisfiledoesntexist!.88", 0, options) == -1);
+    BOOST_REQUIRE(errno == ENOENT);
+}
@@ -21,6 +21,7 @@
 
 #include "../include/Optional.hpp"
 #include "../include/octopOS_driver.hpp"
+#include "../include/restart_scheduler.hpp"
 #include "../include/octopos.h"
 #include "../include/subscriber.h"
 #include "../include/publisher.h"
@@ -86,6 +87,81 @@ BOOST_AUTO_TEST_CASE(module_needs_downgrade_test) {
     BOOST_REQUIRE(module_needs_downgrade(&m2));
 }
 
+BOOST_AUTO_TEST_CASE(module_needs_downgrade_config_test) {
+    Module m(111, 1, time(0));
+    m.config.restart.death_count_cutoff = 2;
+    m.early_death_count = 1;
+    BOOST_REQUIRE(!module_needs_downgrade(&m));
+    BOOST_REQUIRE(module_needs_downgrade(&m));
+}
+
+BOOST_AUTO_TEST_CASE(restart_scheduler_test) {
+    EventLoop loop;
+    RestartScheduler scheduler(&loop);
+    Module m(111, 1, time(0));
+    m.config.restart.jitter = 0;
+    m.early_death_count = 1;
+    BOOST_REQUIRE(scheduler.delay_for(m) == 0);
+    m.early_death_count = 3;
+    BOOST_REQUIRE(scheduler.delay_for(m) ==
+                  m.config.restart.initial_delay_ms *
+                  m.config.restart.multiplier);
+
+    int restarts = 0;
+    scheduler.schedule(0, 10, [&restarts]() { restarts++; });
+    // Rescheduling replaces the pending restart
+    scheduler.schedule(0, 10, [&restarts]() { restarts += 10; });
+    scheduler.schedule(1, 10, [&restarts]() { restarts += 100; });
+    scheduler.cancel(1);
+    BOOST_REQUIRE(scheduler.pending(0));
+    BOOST_REQUIRE(!scheduler.pending(1));
+    BOOST_REQUIRE(scheduler.pending_count() == 1);
+    while (scheduler.pending_count()) {
+        loop.run_once(100);
+    }
+    BOOST_REQUIRE(restarts == 10);
+}
+
+BOOST_AUTO_TEST_CASE(death_cause_test) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        exit(3);
+    }
+    int status;
+    BOOST_REQUIRE(waitpid(pid, &status, 0) == pid);
+    BOOST_REQUIRE(death_cause(status) == DEATH_ERROR_EXIT);
+
+    pid = fork();
+    if (pid == 0) {
+        pause();
+    }
+    BOOST_REQUIRE(kill(pid, SIGSEGV) == 0);
+    BOOST_REQUIRE(waitpid(pid, &status, 0) == pid);
+    BOOST_REQUIRE(death_cause(status) == DEATH_CRASH);
+}
+
+BOOST_AUTO_TEST_CASE(record_death_test) {
+    Module m(111, 1, 1);  // launched a looooong time ago
+    struct rusage usage = {};
+    usage.ru_utime.tv_sec = 2;
+    usage.ru_maxrss = 1024;
+    int segfault = SIGSEGV;  // wait status of a death by SIGSEGV
+    record_death(&m, segfault, usage);
+    BOOST_REQUIRE(m.death_count == 1);
+    BOOST_REQUIRE(m.cpu_time_us == 2000000);
+    BOOST_REQUIRE(m.max_rss_kb == 1024);
+    BOOST_REQUIRE(m.signal_death_count == 1);
+    BOOST_REQUIRE(m.signal_history[0] == SIGSEGV);
+    // Crashes are suspicious no matter how long the module ran
+    BOOST_REQUIRE(!module_needs_downgrade(&m));
+    BOOST_REQUIRE(m.early_death_count == 1);
+
+    record_death(&m, 0, usage);  // clean exit
+    BOOST_REQUIRE(m.cpu_time_us == 4000000);
+    BOOST_REQUIRE(!module_needs_downgrade(&m));
+    BOOST_REQUIRE(m.early_death_count == 0);
+}
+
 BOOST_AUTO_TEST_CASE(find_module_with_test) {
     ModuleInfo modules = {
         {"a", Module(111, 1, 1)},
@@ -114,6 +190,53 @@ BOOST_AUTO_TEST_CASE(relaunch_test) {
     BOOST_REQUIRE(kill(m.pid, SIGTERM) == 0);
 }
 
+BOOST_AUTO_TEST_CASE(relaunch_missing_module_test) {
+    BOOST_REQUIRE_NO_THROW(octopOS::getInstance());
+    Module m(-1, 0, time(0));
+    relaunch(&m, "./thisfiledoesntexist!.88");
+    // The failure is reported right away instead of as a child death
+    BOOST_REQUIRE(m.pid == -1);
+    BOOST_REQUIRE(m.launch_error == ENOENT);
+    relaunch(&m, "./modules/test_module");
+    BOOST_REQUIRE(m.pid > 1);
+    BOOST_REQUIRE(m.launch_error == 0);
+    sleep(1);
+    BOOST_REQUIRE(kill(m.pid, SIGTERM) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(handle_upgrade_requests_test) {
+    BOOST_REQUIRE_NO_THROW(octopOS::getInstance());
+    const FilePath module = "./modules/test_module";
+    ModuleInfo modules = {
+        {"running", Module(launch(module, MSGKEY), 1, time(0))},
+        {module, Module(-1, 2, time(0))},
+        {"retired", Module(-1, 3, time(0))}
+    };
+    modules["retired"].retired = true;
+    pid_t running_pid = modules["running"].pid;
+    BOOST_REQUIRE(running_pid > 1);
+
+    handle_upgrade_requests({"running", module, "running", module, "retired"},
+                            &modules, NULL);
+    // Running modules are killed to be relaunched when their death is
+    // noticed; others are started right away, once
+    BOOST_REQUIRE(modules["running"].killed);
+    BOOST_REQUIRE(modules["running"].pid == running_pid);
+    pid_t relaunched_pid = modules[module].pid;
+    BOOST_REQUIRE(relaunched_pid > 1);
+    BOOST_REQUIRE(modules.slot_with(relaunched_pid).get() ==
+                  modules.slot_of(module).get());
+    BOOST_REQUIRE(modules["retired"].pid == -1);
+
+    // A module already being replaced isn't killed or relaunched again
+    handle_upgrade_requests({"running", "running"}, &modules, NULL);
+    BOOST_REQUIRE(modules["running"].pid == running_pid);
+    BOOST_REQUIRE(waitpid(running_pid, NULL, 0) == running_pid);
+
+    sleep(1);
+    BOOST_REQUIRE(kill(relaunched_pid, SIGTERM) == 0);
+}
+
 // Problem: boost catches sigchld and makes it fail the test case
 // apparently no way to disable without editing source of boost?
 BOOST_AUTO_TEST_CASE(kill_module_test) {
@@ -135,6 +258,23 @@ BOOST_AUTO_TEST_CASE(kill_module_test) {
     BOOST_REQUIRE(result > 1);
 }
 
+BOOST_AUTO_TEST_CASE(diff_modules_test) {
+    ModuleInfo modules = {
+        {"kept", Module(111, 1, 1)},
+        {"removed", Module(222, 2, 1)},
+        {"retired", Module(-1, 3, 1)},
+        {"tuned", Module(444, 4, 1)}
+    };
+    modules["retired"].retired = true;
+    json config = json::parse(std::string(
+        "{\"modules\": {\"tuned\": {\"restart\": {\"jitter\": 0}}}}"));
+    std::list<FilePath> enabled = {"kept", "retired", "tuned", "new"};
+    ModuleDiff diff = diff_modules(modules, enabled, config);
+    BOOST_REQUIRE(diff.added == std::vector<FilePath>({"retired", "new"}));
+    BOOST_REQUIRE(diff.removed == std::vector<FilePath>({"removed"}));
+    BOOST_REQUIRE(diff.reconfigured == std::vector<FilePath>({"tuned"}));
+}
+
 BOOST_AUTO_TEST_CASE(launch_modules_in_test) {
     BOOST_REQUIRE_NO_THROW(octopOS::getInstance());
     const FilePath path = "./modules";
@@ -14,5 +14,53 @@ printf "\n\n--------------------------------------------------\n"
 printf ">>> Running test set 2 <<<\n\n"
 ./octopos_driver_test --catch_system_errors=no
 
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 4 <<<\n\n"
+./event_loop_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 5 <<<\n\n"
+./module_registry_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 6 <<<\n\n"
+./module_spawner_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 7 <<<\n\n"
+./timer_wheel_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 8 <<<\n\n"
+./module_config_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 9 <<<\n\n"
+./listener_pool_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 10 <<<\n\n"
+./config_reloader_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 11 <<<\n\n"
+./shm_ring_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 12 <<<\n\n"
+./mediator_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 13 <<<\n\n"
+./watchdog_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 14 <<<\n\n"
+./journal_test --catch_system_errors=no
+
+printf "\n\n--------------------------------------------------\n"
+printf ">>> Running test set 15 <<<\n\n"
+./metrics_test --catch_system_errors=no
+
 printf "\n\n--------------------------------------------------\n"
 printf "Done running tests."
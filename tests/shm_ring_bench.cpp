@@ -0,0 +1,135 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Benchmark comparing a topic published through a System V
+ * message queue, as OctopOS tentacles do, against a shared memory ring.
+ * The queue path serializes each message to a string, as
+ * `publish_data` does; the ring copies the struct once.
+ *
+ * Usage: shm_ring_bench [messages]
+ */
+
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "../include/shm_ring.hpp"
+
+/** A typical telemetry sample. */
+struct Telemetry {
+    uint64_t sequence;
+    double attitude[4];
+    double rates[3];
+};
+
+struct Message {
+    long type;  // NOLINT
+    char body[256];
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static std::string serialize(const Telemetry &t) {
+    std::ostringstream out;
+    out << t.sequence;
+    for (double value : t.attitude) out << ' ' << value;
+    for (double value : t.rates) out << ' ' << value;
+    return out.str();
+}
+
+static Telemetry deserialize(const char *body) {
+    Telemetry t;
+    std::istringstream in(body);
+    in >> t.sequence;
+    for (double &value : t.attitude) in >> value;
+    for (double &value : t.rates) in >> value;
+    return t;
+}
+
+static Telemetry sample(uint64_t n) {
+    Telemetry t = {n, {0.5, 0.5, 0.5, 0.5}, {0.01, 0.02, 0.03}};
+    return t;
+}
+
+static double bench_message_queue(uint64_t messages) {
+    int msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    Clock::time_point start = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        Message message;
+        message.type = 1;
+        for (uint64_t n = 0; n < messages; n++) {
+            std::string body = serialize(sample(n));
+            strncpy(message.body, body.c_str(), sizeof(message.body));
+            msgsnd(msqid, &message, body.size() + 1, 0);
+        }
+        _exit(0);
+    }
+    Message message;
+    uint64_t checksum = 0;
+    for (uint64_t n = 0; n < messages; n++) {
+        msgrcv(msqid, &message, sizeof(message.body), 0, 0);
+        checksum += deserialize(message.body).sequence;
+    }
+    double seconds = seconds_since(start);
+    waitpid(pid, NULL, 0);
+    msgctl(msqid, IPC_RMID, NULL);
+    return checksum ? messages / seconds : 0;
+}
+
+static double bench_ring(uint64_t messages, uint64_t *dropped) {
+    std::string topic = "bench_" + std::to_string(getpid());
+    ShmRingWriter<Telemetry> setup;
+    setup.open(topic, 4096, 1);
+    ShmRingReader<Telemetry> reader;
+    reader.open(topic);
+    Clock::time_point start = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        ShmRingWriter<Telemetry> writer;
+        writer.open(topic, 4096, 1);
+        for (uint64_t n = 0; n < messages; n++) {
+            writer.publish(sample(n));
+        }
+        _exit(0);
+    }
+    Telemetry t;
+    uint64_t last = 0;
+    while (last + 1 < messages) {
+        if (reader.read(&t)) {
+            last = t.sequence;
+        }
+    }
+    double seconds = seconds_since(start);
+    waitpid(pid, NULL, 0);
+    shm_unlink(shm_ring_name(topic).c_str());
+    *dropped = reader.dropped();
+    return messages / seconds;
+}
+
+int main(int argc, char **argv) {
+    uint64_t messages = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t dropped = 0;
+    double queue_rate = bench_message_queue(messages);
+    double ring_rate = bench_ring(messages, &dropped);
+    printf("%-24s %12.0f msg/s\n", "message queue + strings", queue_rate);
+    printf("%-24s %12.0f msg/s (%llu dropped)\n", "shared memory ring",
+           ring_rate, (unsigned long long)dropped);  // NOLINT
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the shared memory ring transport.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE shm_ring
+// Child deaths are not an error
+#define BOOST_TEST_IGNORE_NON_ZERO_CHILD_CODE
+#define BOOST_TEST_IGNORE_SIGCHLD
+#include <boost/test/unit_test.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../include/shm_ring.hpp"
+
+struct Sample {
+    uint64_t n;
+    uint64_t check;
+    double values[6];
+};
+
+static std::string test_topic(const std::string &name) {
+    std::string topic = "test_" + name + "_" + std::to_string(getpid());
+    shm_unlink(shm_ring_name(topic).c_str());
+    return topic;
+}
+
+static Sample sample(uint64_t n) {
+    Sample s = {n, n * 2654435761u, {0}};
+    return s;
+}
+
+BOOST_AUTO_TEST_CASE(publish_read_test) {
+    std::string topic = test_topic("publish");
+    ShmRingReader<Sample> reader;
+    BOOST_REQUIRE(!reader.open(topic));  // nothing published yet
+
+    ShmRingWriter<Sample> writer;
+    BOOST_REQUIRE(writer.open(topic, 16, 1000));
+    writer.publish(sample(1));
+    BOOST_REQUIRE(reader.open(topic));  // starts after existing messages
+    Sample out;
+    BOOST_REQUIRE(reader.read(&out) == 0);
+
+    writer.publish(sample(2));
+    Sample *in_place = writer.claim();
+    *in_place = sample(3);
+    writer.commit();
+    BOOST_REQUIRE(reader.available() == 2);
+    BOOST_REQUIRE(reader.read(&out) == 1);
+    BOOST_REQUIRE(out.n == 2);
+    BOOST_REQUIRE(reader.read(&out) == 1);
+    BOOST_REQUIRE(out.n == 3);
+    BOOST_REQUIRE(reader.read(&out) == 0);
+    BOOST_REQUIRE(reader.dropped() == 0);
+    shm_unlink(shm_ring_name(topic).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(overrun_test) {
+    std::string topic = test_topic("overrun");
+    ShmRingWriter<Sample> writer;
+    BOOST_REQUIRE(writer.open(topic, 3, 1000));  // rounded up to 4
+    ShmRingReader<Sample> reader;
+    BOOST_REQUIRE(reader.open(topic));
+    for (uint64_t n = 0; n < 10; n++) {
+        writer.publish(sample(n));
+    }
+    // The newest 4 survive; the reader learns how many it missed
+    Sample out;
+    for (uint64_t n = 6; n < 10; n++) {
+        BOOST_REQUIRE(reader.read(&out) == 1);
+        BOOST_REQUIRE(out.n == n);
+    }
+    BOOST_REQUIRE(reader.read(&out) == 0);
+    BOOST_REQUIRE(reader.dropped() == 6);
+    shm_unlink(shm_ring_name(topic).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(restarted_writer_test) {
+    std::string topic = test_topic("restart");
+    ShmRingReader<Sample> reader;
+    {
+        ShmRingWriter<Sample> writer;
+        BOOST_REQUIRE(writer.open(topic, 8, 1000));
+        BOOST_REQUIRE(reader.open(topic));
+        writer.publish(sample(1));
+    }
+    // Relaunched with the same key: same ring, readers unaffected
+    ShmRingWriter<Sample> writer;
+    BOOST_REQUIRE(writer.open(topic, 8, 1000));
+    BOOST_REQUIRE(writer.published() == 1);
+    writer.publish(sample(2));
+    Sample out;
+    BOOST_REQUIRE(reader.read(&out) == 1 && out.n == 1);
+    BOOST_REQUIRE(reader.read(&out) == 1 && out.n == 2);
+
+    // Another module can't publish to the topic too
+    ShmRingWriter<Sample> intruder;
+    BOOST_REQUIRE(!intruder.open(topic, 8, 1001));
+    BOOST_REQUIRE(errno == EBUSY);
+
+    // A new layout replaces the ring, and readers follow
+    ShmRingWriter<Sample> resized;
+    BOOST_REQUIRE(resized.open(topic, 32, 1000));
+    BOOST_REQUIRE(resized.published() == 0);
+    BOOST_REQUIRE(reader.read(&out) == 0);
+    resized.publish(sample(7));
+    BOOST_REQUIRE(reader.read(&out) == 1 && out.n == 7);
+    shm_unlink(shm_ring_name(topic).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(cross_process_test) {
+    std::string topic = test_topic("process");
+    const uint64_t messages = 200000;
+    ShmRingWriter<Sample> setup;
+    BOOST_REQUIRE(setup.open(topic, 64, 1000));
+    ShmRingReader<Sample> reader;
+    BOOST_REQUIRE(reader.open(topic));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        ShmRingWriter<Sample> writer;
+        if (!writer.open(topic, 64, 1000)) {
+            _exit(1);
+        }
+        for (uint64_t n = 0; n < messages; n++) {
+            writer.publish(sample(n));
+        }
+        _exit(0);
+    }
+
+    // The reader may fall behind, but must never see a torn message
+    // or messages out of order
+    uint64_t received = 0, last = 0;
+    bool torn = false, reordered = false;
+    Sample out;
+    while (last + 1 < messages) {
+        if (reader.read(&out)) {
+            torn |= out.check != out.n * 2654435761u;
+            reordered |= received && out.n <= last;
+            last = out.n;
+            received++;
+        }
+    }
+    int status;
+    BOOST_REQUIRE(waitpid(pid, &status, 0) == pid);
+    BOOST_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    BOOST_REQUIRE(!torn);
+    BOOST_REQUIRE(!reordered);
+    BOOST_REQUIRE(received + reader.dropped() == messages);
+    shm_unlink(shm_ring_name(topic).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(doorbell_test) {
+    std::string topic = test_topic("doorbell");
+    const MemKey key = 77;
+    shm_unlink(shm_doorbell_name(key).c_str());
+    ShmRingWriter<Sample> writer;
+    BOOST_REQUIRE(writer.open(topic, 8, 1000));
+    ShmDoorbell doorbell;
+    BOOST_REQUIRE(doorbell.create(key));
+    {
+        // Subscribers are limited, and leaving frees their entry
+        ShmRingReader<Sample> readers[SHM_RING_MAX_SUBSCRIBERS];
+        for (uint32_t i = 0; i < SHM_RING_MAX_SUBSCRIBERS; i++) {
+            BOOST_REQUIRE(readers[i].open(topic));
+            BOOST_REQUIRE(readers[i].subscribe(key + 1 + i));
+        }
+        ShmRingReader<Sample> extra;
+        BOOST_REQUIRE(extra.open(topic));
+        BOOST_REQUIRE(!extra.subscribe(key));
+    }
+    ShmRingReader<Sample> reader;
+    BOOST_REQUIRE(reader.open(topic));
+    BOOST_REQUIRE(reader.subscribe(key));
+
+    // No data: times out
+    uint32_t seen = doorbell.prepare();
+    BOOST_REQUIRE(reader.available() == 0);
+    BOOST_REQUIRE(!doorbell.sleep(seen, 10));
+
+    // Publishing rings the doorbell
+    std::thread publisher([&writer]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        writer.publish(sample(1));
+    });
+    seen = doorbell.prepare();
+    BOOST_REQUIRE(reader.available() == 0);
+    BOOST_REQUIRE(doorbell.sleep(seen, 5000));
+    publisher.join();
+    BOOST_REQUIRE(reader.available() == 1);
+    shm_unlink(shm_ring_name(topic).c_str());
+    shm_unlink(shm_doorbell_name(key).c_str());
+}
@@ -0,0 +1,92 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Benchmark comparing the old fork+execl module launch against
+ * serial and concurrent posix_spawn launches. The parent touches a
+ * large heap first, since fork's cost grows with the driver's size.
+ *
+ * Usage: spawn_bench [module] [count] [heap MiB]
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/module_spawner.hpp"
+
+// The launch path as it was before the spawner
+static pid_t fork_launch(const FilePath &module, MemKey key) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(module.c_str(), std::to_string(key).c_str(), (char*)0);  // NOLINT
+        exit(0);
+    }
+    return pid;
+}
+
+static void reap(size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        wait(NULL);
+    }
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+int main(int argc, char *argv[]) {
+    FilePath module = argc > 1 ? argv[1] : "/bin/true";
+    size_t count = argc > 2 ? atoi(argv[2]) : 200;
+    size_t heap_mib = argc > 3 ? atoi(argv[3]) : 256;
+
+    std::vector<char> heap(heap_mib << 20);
+    memset(&heap[0], 1, heap.size());
+
+    std::vector<SpawnRequest> requests;
+    for (size_t i = 0; i < count; i++) {
+        requests.push_back(SpawnRequest(module, i));
+    }
+
+    Clock::time_point start = Clock::now();
+    for (const SpawnRequest &r : requests) {
+        fork_launch(r.first, r.second);
+    }
+    reap(count);
+    double fork_ms = ms_since(start);
+
+    start = Clock::now();
+    for (const SpawnRequest &r : requests) {
+        spawn_module(r.first, r.second);
+    }
+    reap(count);
+    double spawn_ms = ms_since(start);
+
+    start = Clock::now();
+    spawn_modules(requests);
+    reap(count);
+    double parallel_ms = ms_since(start);
+
+    printf("%zu launches of %s with a %zu MiB parent:\n", count, module.c_str(),
+           heap_mib);
+    printf("  fork+execl (serial)  %8.1f ms  %8.1f us/module\n", fork_ms,
+           fork_ms * 1000 / count);
+    printf("  posix_spawn (serial) %8.1f ms  %8.1f us/module\n", spawn_ms,
+           spawn_ms * 1000 / count);
+    printf("  spawn_modules        %8.1f ms  %8.1f us/module\n", parallel_ms,
+           parallel_ms * 1000 / count);
+    return 0;
+}
@@ -0,0 +1,239 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Benchmarks of the supervisor: boot time of launch_modules_in,
+ * kill-to-relaunch latency, reap throughput during a death storm, and
+ * CPU use while idle, without and with the watchdog checking every
+ * module's heartbeat. Modules are copies of bench_module.
+ *
+ * Results are printed as one JSON object so that they can be tracked
+ * across releases.
+ *
+ * Usage: supervisor_bench [module] [storm size]
+ */
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../include/octopOS_driver.hpp"
+#include "../include/event_loop.hpp"
+#include "../include/restart_scheduler.hpp"
+#include "../include/watchdog.hpp"
+#include "../include/octopos.h"
+#include "../include/publisher.h"
+
+/** The module counts to measure boot time for. */
+static const size_t BOOT_SIZES[] = {1, 10, 100, 1000};
+/** The number of modules running while measuring restart latency. */
+static const size_t LATENCY_MODULES = 50;
+/** The number of restarts to measure latency over. */
+static const size_t LATENCY_SAMPLES = 500;
+/** How long to measure idle CPU use for. */
+static const int IDLE_MS = 2000;
+/** The number of modules watched for hangs. */
+static const size_t WATCHED_MODULES = 1000;
+/** The heartbeat deadline of watched modules. */
+static const int64_t WATCHED_TIMEOUT_MS = 1000;
+
+typedef std::chrono::steady_clock Clock;
+
+static double us_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start)
+        .count();
+}
+
+// Makes a directory of COUNT modules, all links to MODULE
+static std::string make_modules_dir(const std::string &module, size_t count) {
+    char dir_template[] = "/tmp/octopos_bench.XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    for (size_t i = 0; i < count; i++) {
+        std::string link = dir + "/module_" + std::to_string(i);
+        if (symlink(module.c_str(), link.c_str()) == -1) {
+            perror("symlink");
+            exit(1);
+        }
+    }
+    return dir;
+}
+
+static void remove_modules_dir(const std::string &dir, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        unlink((dir + "/module_" + std::to_string(i)).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+static void kill_all(const ModuleInfo &modules) {
+    for (ModuleSlot slot = 0; slot < modules.size(); slot++) {
+        if (modules.at(slot).pid > 0) {
+            kill(modules.at(slot).pid, SIGKILL);
+        }
+    }
+    while (wait(NULL) > 0) { }
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);  // NOLINT
+    return sorted[i];
+}
+
+static void run_for(EventLoop *loop, int ms) {
+    Clock::time_point start = Clock::now();
+    while (us_since(start) < ms * 1000.0) {
+        loop->run_once(ms - (int)(us_since(start) / 1000));  // NOLINT
+    }
+}
+
+static double cpu_us() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec +
+        usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+}
+
+// Runs LOOP until every module in SLOTS has a pid other than the one in
+// OLD_PIDS
+static void run_until_relaunched(EventLoop *loop, const ModuleInfo &modules,
+                                 const std::vector<ModuleSlot> &slots,
+                                 const std::vector<pid_t> &old_pids) {
+    size_t next = 0;
+    while (next < slots.size()) {
+        if (modules.at(slots[next]).pid != old_pids[next] &&
+            modules.at(slots[next]).pid > 0) {
+            next++;
+        } else {
+            loop->run_once(1000);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string module = argc > 1 ? argv[1] : "./bench_module";
+    size_t storm_size = argc > 2 ? atoi(argv[2]) : 500;
+    char resolved[PATH_MAX];
+    if (!realpath(module.c_str(), resolved)) {
+        perror(module.c_str());
+        return 1;
+    }
+    module = resolved;
+
+    block_child_signals();
+    octopOS::getInstance();
+    MemKey next_key = MSGKEY;
+    publisher<OctoString> downgrade_pub(DOWNGRADE_TOPIC, next_key++);
+
+    printf("{\n  \"boot\": [");
+    for (size_t i = 0; i < sizeof(BOOT_SIZES) / sizeof(BOOT_SIZES[0]); i++) {
+        size_t count = BOOT_SIZES[i];
+        std::string dir = make_modules_dir(module, count);
+        Clock::time_point start = Clock::now();
+        LaunchInfo launched = launch_modules_in(dir, next_key);
+        double elapsed_us = us_since(start);
+        kill_all(launched.first);
+        remove_modules_dir(dir, count);
+        printf("%s\n    {\"modules\": %zu, \"ms\": %.3f, "
+               "\"us_per_module\": %.1f}", i ? "," : "", count,
+               elapsed_us / 1000, elapsed_us / count);
+    }
+    printf("\n  ],\n");
+
+    size_t running = std::max(LATENCY_MODULES, storm_size);
+    std::string dir = make_modules_dir(module, running);
+    ModuleInfo modules = launch_modules_in(dir, next_key).first;
+    EventLoop loop;
+    RestartScheduler scheduler(&loop);
+    loop.watch_signal(SIGCHLD, [&]() {
+        reboot_dead_modules(&modules, &downgrade_pub, &scheduler);
+    });
+
+    // Kill-to-relaunch latency of intentional deaths
+    std::vector<double> latencies;
+    for (size_t i = 0; i < LATENCY_SAMPLES; i++) {
+        ModuleSlot slot = i % LATENCY_MODULES;
+        std::vector<ModuleSlot> slots(1, slot);
+        std::vector<pid_t> old_pids(1, modules.at(slot).pid);
+        Clock::time_point start = Clock::now();
+        kill_module(modules.path_of(slot), &modules);
+        run_until_relaunched(&loop, modules, slots, old_pids);
+        latencies.push_back(us_since(start));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("  \"restart_latency_us\": {\"samples\": %zu, \"p50\": %.1f, "
+           "\"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f},\n",
+           latencies.size(), percentile(latencies, 0.5),
+           percentile(latencies, 0.9), percentile(latencies, 0.99),
+           latencies.back());
+
+    // Every module dies at once
+    std::vector<ModuleSlot> slots;
+    std::vector<pid_t> old_pids;
+    for (ModuleSlot slot = 0; slot < storm_size; slot++) {
+        slots.push_back(slot);
+        old_pids.push_back(modules.at(slot).pid);
+    }
+    Clock::time_point start = Clock::now();
+    for (ModuleSlot slot : slots) {
+        kill_module(modules.path_of(slot), &modules);
+    }
+    run_until_relaunched(&loop, modules, slots, old_pids);
+    double storm_us = us_since(start);
+    printf("  \"death_storm\": {\"modules\": %zu, \"ms\": %.3f, "
+           "\"reaps_per_s\": %.0f},\n", storm_size, storm_us / 1000,
+           storm_size * 1e6 / storm_us);
+
+    // Nothing dies, so the driver should use no CPU at all
+    double cpu_start = cpu_us();
+    run_for(&loop, IDLE_MS);
+    double idle_cpu_us = cpu_us() - cpu_start;
+    printf("  \"idle\": {\"modules\": %zu, \"seconds\": %.1f, "
+           "\"cpu_ms\": %.3f, \"cpu_percent\": %.4f},\n", running,
+           IDLE_MS / 1000.0, idle_cpu_us / 1000,
+           idle_cpu_us / (IDLE_MS * 10.0));
+    kill_all(modules);
+    remove_modules_dir(dir, running);
+
+    // The same, with every module's heartbeat being checked
+    dir = make_modules_dir(module, WATCHED_MODULES);
+    ModuleInfo watched = launch_modules_in(dir, next_key).first;
+    for (ModuleSlot slot = 0; slot < watched.size(); slot++) {
+        watched.at(slot).config.watchdog.timeout_ms = WATCHED_TIMEOUT_MS;
+        watched.at(slot).config.watchdog.startup_grace_ms =
+            WATCHED_TIMEOUT_MS;
+    }
+    Watchdog watchdog(&loop, &watched);
+    watchdog.start();
+    // Let every module find its entry and the checks settle
+    run_for(&loop, 2 * HEARTBEAT_ATTACH_RETRY_MS + WATCHED_TIMEOUT_MS);
+    cpu_start = cpu_us();
+    run_for(&loop, IDLE_MS);
+    idle_cpu_us = cpu_us() - cpu_start;
+    printf("  \"watchdog\": {\"modules\": %zu, \"timeout_ms\": %lld, "
+           "\"seconds\": %.1f, \"cpu_ms\": %.3f, \"cpu_percent\": %.4f, "
+           "\"hangs\": %llu}\n", watchdog.watched_count(),
+           (long long)WATCHED_TIMEOUT_MS, IDLE_MS / 1000.0,  // NOLINT
+           idle_cpu_us / 1000, idle_cpu_us / (IDLE_MS * 10.0),
+           (unsigned long long)watchdog.hangs_detected());  // NOLINT
+    printf("}\n");
+
+    kill_all(watched);
+    remove_modules_dir(dir, WATCHED_MODULES);
+    return 0;
+}
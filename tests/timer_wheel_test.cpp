@@ -0,0 +1,106 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for the timer wheel.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE timer_wheel
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "../include/timer_wheel.hpp"
+
+BOOST_AUTO_TEST_CASE(fires_at_deadline_test) {
+    TimerWheel wheel(1000);
+    int fired = 0;
+    wheel.schedule(1010, [&]() { fired++; });
+    BOOST_REQUIRE(wheel.size() == 1);
+    BOOST_REQUIRE(wheel.next_deadline().get() == 1010);
+    BOOST_REQUIRE(wheel.advance(1009) == 0);
+    BOOST_REQUIRE(fired == 0);
+    BOOST_REQUIRE(wheel.advance(1010) == 1);
+    BOOST_REQUIRE(fired == 1);
+    BOOST_REQUIRE(wheel.size() == 0);
+    BOOST_REQUIRE(wheel.next_deadline().isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(cancel_test) {
+    TimerWheel wheel(0);
+    int fired = 0;
+    TimerId id = wheel.schedule(500, [&]() { fired++; });
+    BOOST_REQUIRE(wheel.cancel(id));
+    BOOST_REQUIRE(!wheel.cancel(id));
+    // A reused entry must not be cancelled through a stale ID
+    TimerId reused = wheel.schedule(600, [&]() { fired++; });
+    BOOST_REQUIRE(!wheel.cancel(id));
+    wheel.advance(1000);
+    BOOST_REQUIRE(fired == 1);
+    BOOST_REQUIRE(!wheel.cancel(reused));
+}
+
+BOOST_AUTO_TEST_CASE(past_deadline_test) {
+    TimerWheel wheel(100);
+    int fired = 0;
+    wheel.schedule(5, [&]() { fired++; });
+    BOOST_REQUIRE(wheel.advance(101) == 1);
+    BOOST_REQUIRE(fired == 1);
+}
+
+BOOST_AUTO_TEST_CASE(callbacks_can_reschedule_test) {
+    TimerWheel wheel(0);
+    int fired = 0;
+    std::function<void()> tick = [&]() {
+        if (++fired < 5) {
+            wheel.schedule(fired * 100, tick);
+        }
+    };
+    wheel.schedule(0, tick);
+    wheel.advance(10000);
+    BOOST_REQUIRE(fired == 5);
+}
+
+BOOST_AUTO_TEST_CASE(matches_sorted_order_test) {
+    // Compare against a simple ordered map over deadlines spanning
+    // every level of the wheel, advancing in uneven steps
+    srand(42);
+    int64_t start = 123456789;
+    TimerWheel wheel(start);
+    std::multimap<int64_t, int> expected;
+    std::vector<std::pair<int64_t, int> > fired;
+    std::vector<int64_t> deadlines;
+    int64_t now = start;
+    for (int i = 0; i < 5000; i++) {
+        int64_t spans[] = {300, 70000, 20000000, 5000000000LL};
+        int64_t deadline = now + rand() % spans[i % 4];
+        deadlines.push_back(deadline > now ? deadline : now + 1);
+        expected.insert(std::make_pair(deadlines.back(), i));
+        wheel.schedule(deadline, [&fired, &now, i]() {
+            fired.push_back(std::make_pair(now, i));
+        });
+    }
+    while (wheel.size()) {
+        CDH::Optional<int64_t> next = wheel.next_deadline();
+        BOOST_REQUIRE(!next.isEmpty());
+        BOOST_REQUIRE(next.get() <= expected.begin()->first);
+        now = next.get();
+        wheel.advance(now);
+        while (!expected.empty() && expected.begin()->first <= now) {
+            expected.erase(expected.begin());
+        }
+        BOOST_REQUIRE(wheel.size() == expected.size());
+    }
+    BOOST_REQUIRE(fired.size() == 5000);
+    for (auto &f : fired) {
+        // Every timer fires exactly on its deadline
+        BOOST_REQUIRE(f.first == deadlines[f.second]);
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief Test for detecting hung modules from their heartbeats.
+ * These tests are in seperate files to avoid strange boost scoping.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE watchdog
+// Child deaths are not an error
+#define BOOST_TEST_IGNORE_NON_ZERO_CHILD_CODE
+#define BOOST_TEST_IGNORE_SIGCHLD
+#include <boost/test/unit_test.hpp>
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <functional>
+
+#include "../include/watchdog.hpp"
+
+// Runs LOOP until DONE or a few seconds pass
+static bool run_until(EventLoop *loop, std::function<bool()> done) {
+    for (int i = 0; i < 100 && !done(); i++) {
+        loop->run_once(50);
+    }
+    return done();
+}
+
+// Forks a stand-in module that beats every 20 ms, or never
+static pid_t fork_module(int tentacle_id, bool beats) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        Heartbeat heartbeat(tentacle_index_to_memkey(tentacle_id));
+        while (1) {
+            if (beats) {
+                heartbeat.beat();
+            }
+            usleep(20 * 1000);
+        }
+    }
+    return pid;
+}
+
+static bool killed_by(pid_t pid, int signo) {
+    int status;
+    return waitpid(pid, &status, WNOHANG) == pid && WIFSIGNALED(status) &&
+        WTERMSIG(status) == signo;
+}
+
+BOOST_AUTO_TEST_CASE(watchdog_test) {
+    ModuleConfig watched;
+    watched.watchdog.timeout_ms = 100;
+    watched.watchdog.startup_grace_ms = 200;
+    ModuleInfo modules;
+    const char *paths[] = {"/modules/healthy", "/modules/hung",
+                           "/modules/unwatched"};
+    for (int i = 0; i < 3; i++) {
+        ModuleSlot slot = modules.add(paths[i], Module(-1, i + 1, time(0)));
+        if (i < 2) {
+            modules.at(slot).config = watched;
+        }
+    }
+
+    EventLoop loop;
+    Watchdog watchdog(&loop, &modules);
+    BOOST_REQUIRE(watchdog.start());
+    BOOST_REQUIRE(watchdog.watched_count() == 2);
+
+    pid_t healthy = fork_module(1, true);
+    pid_t hung = fork_module(2, false);
+    pid_t unwatched = fork_module(3, false);
+    modules.at(0).pid = healthy;
+    modules.at(1).pid = hung;
+    modules.at(2).pid = unwatched;
+
+    bool hung_killed = false;
+    BOOST_REQUIRE(run_until(&loop, [&]() {
+        return hung_killed || (hung_killed = killed_by(hung, SIGKILL));
+    }));
+    BOOST_REQUIRE(modules.at(1).hang_count == 1);
+    modules.at(1).pid = -1;
+    // Give the others a few more deadlines
+    for (int i = 0; i < 8; i++) {
+        loop.run_once(50);
+    }
+    BOOST_REQUIRE(watchdog.hangs_detected() == 1);
+    BOOST_REQUIRE(modules.at(0).hang_count == 0);
+    BOOST_REQUIRE(modules.at(2).hang_count == 0);
+    BOOST_REQUIRE(waitpid(healthy, NULL, WNOHANG) == 0);
+    BOOST_REQUIRE(waitpid(unwatched, NULL, WNOHANG) == 0);
+
+    // A module reconfigured to be unwatched stops being checked
+    modules.at(0).config = ModuleConfig();
+    watchdog.sync();
+    BOOST_REQUIRE(watchdog.watched_count() == 1);
+
+    kill(healthy, SIGKILL);
+    kill(unwatched, SIGKILL);
+    waitpid(healthy, NULL, 0);
+    waitpid(unwatched, NULL, 0);
+}
@@ -0,0 +1,38 @@
+// Copyright 2017 Space HAUC Command and Data Handling
+// This file is part of Space HAUC which is released under AGPLv3.
+// See file LICENSE.txt or go to <http://www.gnu.org/licenses/> for full
+// license details.
+
+/*!
+ * @file
+ *
+ * @brief An example module built on a specialized Mediator. It reports
+ * every x published on the example.x topic on the example.msg topic.
+ */
+
+#include <cstdio>
+#include <iostream>
+
+#include "../include/mediator/example_mediator.hpp"
+
+int main(int argc, char const *argv[]) {
+    if (argc < 1) {
+        std::cerr << "Critical Error: Launched without a memory key. "
+                  << "Exiting..." << std::endl;
+        return 1;
+    }
+    ExampleMediator mediator =
+        ExampleMediator::create(module_memkey(argv[0]));
+    if (!mediator.init()) {
+        return 1;
+    }
+
+    mediator.on<ExampleXTopic>([&mediator](const ExampleInData &in) {
+        ExampleMediator::OutData out;
+        snprintf(out.msg, sizeof(out.msg), "x has been published: %d", in.x);
+        mediator.publish_data(out);
+    });
+    // Sleeps until x is published
+    mediator.run();
+    return 0;
+}